@@ -0,0 +1,1087 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-
+ *
+ *  desd-bench.cpp
+ *
+ *  Author: desd-controller contributors
+ *
+ *  Modified version: this file is not part of the original desd-controller
+ *  sources by Michael Catanzaro <michael.catanzaro@mst.edu>.
+ *
+ *  These source code files were created at Missouri University of Science and
+ *  Technology, and are intended for use in teaching or research. They may be
+ *  freely copied, modified, and redistributed as long as modified versions are
+ *  clearly marked as such and this notice is not removed. Neither the authors
+ *  nor Missouri S&T make any warranty, express or implied, nor assume any legal
+ *  responsibility for the accuracy, completeness, or usefulness of these files
+ *  or any information distributed with these files.
+ *
+ *  Suggested modifications or questions about these files can be directed to
+ *  Dr. Bruce McMillin, Department of Computer Science, Missouri University of
+ *  Science and Technology, Rolla, MO 65409 <ff@mst.edu>.
+ */
+
+/*
+ * Benchmarks the controller against a simulated DGI and a simulated DESD
+ * whose links misbehave according to a fault profile. The controller runs
+ * unmodified in a child process, connected to the simulated DGI over TCP and
+ * to the simulated DESD over a pseudoterminal. Faults are injected by wrapping
+ * the simulators' ends of both links in a FaultStream, and a watchdog restarts
+ * the controller if it stops making progress, since it has no I/O timeouts of
+ * its own.
+ */
+
+#include "dgi-interface.hpp"
+#include "fault-stream.hpp"
+#include "io-interface.hpp"
+#include "monotonic-clock.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/program_options.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace po = boost::program_options;
+
+namespace {
+
+/* Must match what the controller sends */
+const std::string hello_message = "Hello\r\ndesd-controller\r\nSst DESD1\r\n";
+const std::string device_name = "DESD1";
+const std::string device_signal = "gateway";
+const std::string null_command = "100000000";
+
+/// Seconds between intro prompts while waiting for the controller to start
+const double prompt_interval = 0.1;
+
+/// Fewest samples that must lie beyond a tail percentile for it to be reported
+const double min_tail_samples = 10;
+
+/**
+ * Waits for a file descriptor to become readable
+ *
+ * @param fd the file descriptor
+ * @param timeout_ms how long to wait
+ *
+ * @return true if the descriptor is readable
+ */
+bool WaitReadable(int fd, int timeout_ms)
+{
+    pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    return ::poll(&pfd, 1, timeout_ms) > 0;
+}
+
+/**
+ * Prevents a file descriptor from leaking into the controller process
+ *
+ * @param fd the file descriptor
+ */
+void SetCloseOnExec(int fd)
+{
+    ::fcntl(fd, F_SETFD, ::fcntl(fd, F_GETFD) | FD_CLOEXEC);
+}
+
+/**
+ * Computes a percentile by the nearest-rank method
+ *
+ * @param samples the data, which need not be sorted
+ * @param p the percentile, as a fraction
+ *
+ * @return the percentile, or zero if there are no samples
+ */
+double Percentile(std::vector<double> samples, double p)
+{
+    if (samples.empty())
+        return 0;
+
+    std::sort(samples.begin(), samples.end());
+    std::size_t rank = static_cast<std::size_t>(std::ceil(p * samples.size()));
+    return samples[rank > 0 ? rank - 1 : 0];
+}
+
+/**
+ * Formats a tail percentile in milliseconds. With too few samples beyond it,
+ * e.g. p999 of 2000 samples, which is just the second largest, it would say
+ * nothing about the tail, so a dash is printed instead.
+ *
+ * @param samples the data in seconds, which need not be sorted
+ * @param p the percentile, as a fraction
+ *
+ * @return the percentile, or "-"
+ */
+std::string TailPercentile(const std::vector<double>& samples, double p)
+{
+    if (samples.size() * (1 - p) < min_tail_samples)
+        return "-";
+
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(2) << 1e3 * Percentile(samples, p);
+    return ss.str();
+}
+
+/**
+ * Counts the lines of a file that contain a string
+ *
+ * @param filename the file to search
+ * @param needle the string to search for
+ *
+ * @return number of matching lines
+ */
+unsigned CountLines(const std::string& filename, const std::string& needle)
+{
+    std::ifstream file(filename.c_str());
+    std::string line;
+    unsigned count = 0;
+    while (std::getline(file, line))
+    {
+        if (line.find(needle) != std::string::npos)
+            count++;
+    }
+    return count;
+}
+
+/**
+ * Holds a pthread mutex for the lifetime of the object
+ */
+class ScopedLock
+{
+public:
+    /// Constructor
+    explicit ScopedLock(pthread_mutex_t& mutex) : m_mutex(mutex)
+    {
+        ::pthread_mutex_lock(&m_mutex);
+    }
+    /// Destructor
+    ~ScopedLock()
+    {
+        ::pthread_mutex_unlock(&m_mutex);
+    }
+
+private:
+    /// The held mutex
+    pthread_mutex_t& m_mutex;
+};
+
+/**
+ * Collects the results of a benchmark run. Shared by the simulator threads
+ * and the supervisor.
+ */
+class Recorder : public FaultListener
+{
+public:
+    /// Constructor
+    Recorder();
+    /// Destructor
+    ~Recorder();
+    /// Counts a fault and starts its recovery clock
+    void OnFault(FaultClass fault);
+    /// Counts a completed cycle and stops all recovery clocks
+    void OnCycle(double interval);
+    /// Resets the progress clock without counting a cycle
+    void Touch();
+    /// Number of cycles completed
+    unsigned Cycles();
+    /// Time of the last cycle completion or call to Touch()
+    double LastProgress();
+    /// Prints cycle latency and fault recovery statistics
+    void Report(std::ostream& os);
+
+private:
+    /// Protects everything below
+    pthread_mutex_t m_mutex;
+    /// Number of cycles completed
+    unsigned m_cycles;
+    /// Time of the last cycle completion or call to Touch()
+    double m_last_progress;
+    /// Seconds between consecutive cycles within a session
+    std::vector<double> m_latencies;
+    /// Number of faults injected, by class
+    unsigned m_faults[FAULT_CLASS_COUNT];
+    /// Time of the first fault not yet followed by a cycle, or negative
+    double m_pending[FAULT_CLASS_COUNT];
+    /// Seconds from a fault to the next completed cycle, by class
+    std::vector<double> m_recoveries[FAULT_CLASS_COUNT];
+};
+
+Recorder::Recorder()
+    : m_cycles(0),
+      m_last_progress(MonotonicSeconds())
+{
+    ::pthread_mutex_init(&m_mutex, 0);
+    for (int i = 0; i < FAULT_CLASS_COUNT; i++)
+    {
+        m_faults[i] = 0;
+        m_pending[i] = -1;
+    }
+}
+
+Recorder::~Recorder()
+{
+    ::pthread_mutex_destroy(&m_mutex);
+}
+
+/**
+ * @param fault the class of the injected fault
+ */
+void Recorder::OnFault(FaultClass fault)
+{
+    ScopedLock lock(m_mutex);
+    m_faults[fault]++;
+    if (m_pending[fault] < 0)
+        m_pending[fault] = MonotonicSeconds();
+}
+
+/**
+ * @param interval seconds since the previous cycle of the same session, or
+ *        negative if this is the first cycle of its session
+ */
+void Recorder::OnCycle(double interval)
+{
+    ScopedLock lock(m_mutex);
+    double now = MonotonicSeconds();
+
+    m_cycles++;
+    m_last_progress = now;
+    if (interval >= 0)
+        m_latencies.push_back(interval);
+
+    for (int i = 0; i < FAULT_CLASS_COUNT; i++)
+    {
+        if (m_pending[i] >= 0)
+        {
+            m_recoveries[i].push_back(now - m_pending[i]);
+            m_pending[i] = -1;
+        }
+    }
+}
+
+void Recorder::Touch()
+{
+    ScopedLock lock(m_mutex);
+    m_last_progress = MonotonicSeconds();
+}
+
+unsigned Recorder::Cycles()
+{
+    ScopedLock lock(m_mutex);
+    return m_cycles;
+}
+
+double Recorder::LastProgress()
+{
+    ScopedLock lock(m_mutex);
+    return m_last_progress;
+}
+
+/**
+ * @param os where to print the report
+ */
+void Recorder::Report(std::ostream& os)
+{
+    ScopedLock lock(m_mutex);
+    double max = m_latencies.empty() ? 0 :
+        *std::max_element(m_latencies.begin(), m_latencies.end());
+
+    os << std::fixed << std::setprecision(2)
+       << "  cycle latency (ms, " << m_latencies.size() << " samples): p50 "
+       << 1e3 * Percentile(m_latencies, 0.5)
+       << "  p99 " << TailPercentile(m_latencies, 0.99)
+       << "  p999 " << TailPercentile(m_latencies, 0.999)
+       << "  max " << 1e3 * max << "\n";
+
+    os << "  " << std::left << std::setw(14) << "fault" << std::right
+       << std::setw(10) << "injected" << std::setw(11) << "recovered"
+       << std::setw(12) << "p50 ms" << std::setw(12) << "p99 ms"
+       << std::setw(12) << "max ms" << "\n";
+    for (int i = 0; i < FAULT_CLASS_COUNT; i++)
+    {
+        const std::vector<double>& samples = m_recoveries[i];
+        if (m_faults[i] == 0)
+            continue;
+
+        double worst = samples.empty() ? 0 :
+            *std::max_element(samples.begin(), samples.end());
+        os << "  " << std::left << std::setw(14)
+           << FaultName(static_cast<FaultClass>(i)) << std::right
+           << std::setw(10) << m_faults[i]
+           << std::setw(11) << samples.size()
+           << std::setw(12) << 1e3 * Percentile(samples, 0.5)
+           << std::setw(12) << TailPercentile(samples, 0.99)
+           << std::setw(12) << 1e3 * worst << "\n";
+    }
+}
+
+/**
+ * The simulated DGI's end of one plug and play session.
+ */
+class FakeDgi : public IOInterface<FaultStream<boost::asio::ip::tcp::socket> >
+{
+public:
+    /// Constructor
+    FakeDgi(boost::asio::ip::tcp::socket& socket, const FaultProfile& profile,
+            unsigned seed, Recorder& recorder);
+    /// Runs the session until the connection fails
+    void Serve();
+
+private:
+    /// Sends a BadRequest, then waits for the controller to hang up
+    void Reject(const std::string& reason);
+    /// Receives a message from the controller
+    std::string ReadMessage();
+
+    /// The socket, wrapped with fault injection
+    FaultStream<boost::asio::ip::tcp::socket> m_stream;
+    /// Where to record completed cycles
+    Recorder& m_recorder;
+};
+
+/**
+ * @param socket connected to the controller
+ * @param profile the faults to inject
+ * @param seed seed for the fault generator
+ * @param recorder where to record faults and completed cycles
+ */
+FakeDgi::FakeDgi(boost::asio::ip::tcp::socket& socket,
+                 const FaultProfile& profile, unsigned seed,
+                 Recorder& recorder)
+    : IOInterface(m_stream),
+      m_stream(socket, profile, seed, &recorder),
+      m_recorder(recorder)
+{
+}
+
+/**
+ * Plays the DGI's part of the protocol, alternating between real and null
+ * commands.
+ *
+ * @ErrorHandling throws std::exception when the session ends
+ */
+void FakeDgi::Serve()
+{
+    if (ReadMessage() != hello_message)
+        Reject("Malformed Hello");
+    Write("Start\r\n\r\n");
+
+    double last_cycle = -1;
+    for (unsigned cycle = 0; ; cycle++)
+    {
+        std::istringstream iss(ReadMessage());
+        std::string type, device, signal;
+        float power_level;
+        iss >> type >> device >> signal >> power_level;
+        if (!iss || type != "DeviceStates" || device != device_name ||
+            signal != device_signal)
+        {
+            Reject("Malformed DeviceStates");
+        }
+
+        double now = MonotonicSeconds();
+        m_recorder.OnCycle(last_cycle < 0 ? -1 : now - last_cycle);
+        last_cycle = now;
+
+        std::string command = null_command;
+        if (cycle % 2)
+            command = boost::lexical_cast<std::string>(
+                static_cast<int>(cycle % 41) * 500 - 10000);
+        Write("DeviceCommands\r\n" +
+              device_name + " " + device_signal + " " + command + "\r\n\r\n");
+    }
+}
+
+/**
+ * @param reason explanation sent along with the BadRequest
+ *
+ * @ErrorHandling always throws std::exception
+ */
+void FakeDgi::Reject(const std::string& reason)
+{
+    Write("BadRequest\r\n" + reason + "\r\n\r\n");
+    for (;;)
+        (void) ReadLine();
+}
+
+/**
+ * @return the message, without its terminating blank line
+ */
+std::string FakeDgi::ReadMessage()
+{
+    std::string message, line;
+    while ((line = ReadLine()) != "\r\n")
+        message += line;
+    return message;
+}
+
+/**
+ * The simulated DESD. Answers the start, stop, measure, and power commands
+ * over the master side of a pseudoterminal.
+ */
+class FakeDesd
+{
+public:
+    /// Constructor
+    FakeDesd(boost::asio::posix::stream_descriptor& master,
+             const FaultProfile& profile, unsigned seed, Recorder& recorder);
+    /// Destructor
+    ~FakeDesd();
+    /// Forget the previous controller and prompt for a new one
+    void Reset();
+    /// Makes Run() return
+    void Stop();
+    /// Serves the controller until stopped
+    void Run();
+
+private:
+    /// Handles one byte from the controller
+    void Handle(char c);
+    /// Executes a complete, valid command
+    void Execute(int value, char command);
+    /// Sends a reply to the controller
+    void Reply(const std::string& reply);
+
+    /// Master side of the pseudoterminal
+    boost::asio::posix::stream_descriptor& m_master;
+    /// The faults to inject
+    FaultProfile m_profile;
+    /// Seed for the fault generator
+    unsigned m_seed;
+    /// Where to record faults
+    Recorder& m_recorder;
+
+    /// Protects m_generation and m_stop
+    pthread_mutex_t m_mutex;
+    /// Incremented each time a new controller is started
+    unsigned m_generation;
+    /// Whether Run() should return
+    bool m_stop;
+
+    /// The master, wrapped with fault injection
+    boost::scoped_ptr<FaultStream<boost::asio::posix::stream_descriptor> >
+        m_stream;
+    /// Whether the current link has been dropped by the fault stream
+    bool m_silent;
+    /// Partial command received so far
+    std::string m_command;
+    /// Last commanded power level
+    int m_power_level;
+};
+
+/**
+ * @param master the master side of the pseudoterminal
+ * @param profile the faults to inject
+ * @param seed seed for the fault generator
+ * @param recorder where to record faults
+ */
+FakeDesd::FakeDesd(boost::asio::posix::stream_descriptor& master,
+                   const FaultProfile& profile, unsigned seed,
+                   Recorder& recorder)
+    : m_master(master),
+      m_profile(profile),
+      m_seed(seed),
+      m_recorder(recorder),
+      m_generation(0),
+      m_stop(false),
+      m_silent(false),
+      m_power_level(0)
+{
+    ::pthread_mutex_init(&m_mutex, 0);
+}
+
+FakeDesd::~FakeDesd()
+{
+    ::pthread_mutex_destroy(&m_mutex);
+}
+
+void FakeDesd::Reset()
+{
+    ScopedLock lock(m_mutex);
+    m_generation++;
+}
+
+void FakeDesd::Stop()
+{
+    ScopedLock lock(m_mutex);
+    m_stop = true;
+}
+
+/**
+ * Serves one controller after another. A dropped link stays silent until the
+ * next Reset(), like a DESD whose cable has been pulled.
+ */
+void FakeDesd::Run()
+{
+    unsigned seen_generation = 0;
+    double last_prompt = 0;
+    bool prompting = false;
+
+    for (;;)
+    {
+        unsigned generation;
+        {
+            ScopedLock lock(m_mutex);
+            if (m_stop)
+                return;
+            generation = m_generation;
+        }
+
+        if (generation != seen_generation)
+        {
+            seen_generation = generation;
+            m_stream.reset(
+                new FaultStream<boost::asio::posix::stream_descriptor>(
+                    m_master, m_profile, m_seed + generation, &m_recorder));
+            m_silent = false;
+            m_command.clear();
+            prompting = true;
+            last_prompt = 0;
+        }
+
+        // The controller flushes the terminal after opening it, so keep
+        // prompting until it has clearly seen a prompt
+        if (prompting && !m_silent &&
+            MonotonicSeconds() - last_prompt > prompt_interval)
+        {
+            Reply("\r\nDESD");
+            last_prompt = MonotonicSeconds();
+        }
+
+        if (!WaitReadable(m_master.native_handle(), 10))
+            continue;
+
+        char buffer[64];
+        boost::system::error_code ec;
+        if (!m_stream || m_silent)
+        {
+            (void) m_master.read_some(boost::asio::buffer(buffer), ec);
+            continue;
+        }
+
+        std::size_t size = m_stream->read_some(boost::asio::buffer(buffer), ec);
+        if (ec)
+        {
+            m_silent = true;
+            continue;
+        }
+
+        prompting = false;
+        for (std::size_t i = 0; i < size; i++)
+            Handle(buffer[i]);
+    }
+}
+
+/**
+ * Commands are six characters of sign and digits followed by a letter.
+ *
+ * @param c the next byte from the controller
+ */
+void FakeDesd::Handle(char c)
+{
+    if (std::isdigit(static_cast<unsigned char>(c)) || c == '-')
+    {
+        if (m_command.size() < 16)
+            m_command += c;
+        return;
+    }
+
+    std::string command = m_command + c;
+    m_command.clear();
+
+    bool valid = command.size() == 7 && std::strchr("smp", c) != 0 &&
+        (std::isdigit(static_cast<unsigned char>(command[0])) ||
+         (command[0] == '-' && c == 'p'));
+    for (std::size_t i = 1; valid && i < 6; i++)
+        valid = std::isdigit(static_cast<unsigned char>(command[i])) != 0;
+
+    if (valid)
+        Execute(std::atoi(command.c_str()), c);
+    else
+        Reply("unrecognized command: " + command + "\r\n");
+}
+
+/**
+ * @param value the numeric field of the command
+ * @param command the command letter
+ */
+void FakeDesd::Execute(int value, char command)
+{
+    switch (command)
+    {
+    case 's':
+        // The controller does not read a reply to the stop command
+        if (value != 0)
+            Reply("Started: 1\r\n");
+        break;
+    case 'm':
+        Reply("Power level: " +
+              boost::lexical_cast<std::string>(m_power_level) + " W\r\n");
+        break;
+    case 'p':
+        m_power_level = value;
+        Reply("Power set to " +
+              boost::lexical_cast<std::string>(m_power_level) + " W\r\n");
+        break;
+    }
+}
+
+/**
+ * @param reply the bytes to send
+ */
+void FakeDesd::Reply(const std::string& reply)
+{
+    boost::system::error_code ec;
+    boost::asio::write(*m_stream, boost::asio::buffer(reply),
+                       boost::asio::transfer_all(), ec);
+    if (ec)
+        m_silent = true;
+}
+
+/**
+ * Runs one fault profile against a freshly started controller.
+ */
+class Bench
+{
+public:
+    /// Constructor
+    Bench(const FaultProfile& dgi_faults, const FaultProfile& desd_faults,
+          unsigned seed, const std::string& log_file);
+    /// Destructor
+    ~Bench();
+    /// Runs until enough cycles complete or time runs out
+    void Run(unsigned cycles, double watchdog, double time_limit);
+    /// Prints the results
+    void Report(std::ostream& os);
+
+private:
+    /// Entry point of the simulated DGI thread
+    static void* ServeDgiThread(void* bench);
+    /// Entry point of the simulated DESD thread
+    static void* ServeDesdThread(void* bench);
+    /// Accepts and serves controller sessions until stopped
+    void ServeDgi();
+    /// Whether the simulators should stop
+    bool Stopping();
+    /// Starts a new controller process
+    void SpawnController();
+    /// Kills the current controller process, if any
+    void KillController();
+
+    /// Used for the simulators' synchronous I/O
+    boost::asio::io_service m_io_service;
+    /// Listens for the controller on a loopback port
+    boost::asio::ip::tcp::acceptor m_acceptor;
+    /// Master side of the pseudoterminal
+    boost::asio::posix::stream_descriptor m_master;
+    /// Slave side, held open so the master never sees a hangup
+    int m_slave_fd;
+    /// Path of the slave side, passed to the controller
+    std::string m_slave_name;
+    /// Faults to inject on the DGI link
+    FaultProfile m_dgi_faults;
+    /// Seed for fault generators
+    unsigned m_seed;
+    /// Where the controller's output goes
+    std::string m_log_file;
+    /// Collects the results
+    Recorder m_recorder;
+    /// The simulated DESD
+    FakeDesd m_desd;
+    /// Protects m_stop
+    pthread_mutex_t m_mutex;
+    /// Whether the simulators should stop
+    bool m_stop;
+    /// The running controller, or -1
+    pid_t m_controller;
+    /// Controllers killed for making no progress
+    unsigned m_watchdog_restarts;
+    /// Controllers that exited on their own
+    unsigned m_exits;
+    /// Wall time the run took
+    double m_elapsed;
+};
+
+/**
+ * Opens a pseudoterminal for the simulated DESD and a loopback port for the
+ * simulated DGI.
+ *
+ * @ErrorHandling throws std::runtime_error if the pseudoterminal cannot be
+ *      created, or boost::system::system_error if the port cannot be opened
+ *
+ * @param dgi_faults faults to inject on the DGI link
+ * @param desd_faults faults to inject on the DESD link
+ * @param seed seed for the fault generators
+ * @param log_file where to write the controller's output
+ */
+Bench::Bench(const FaultProfile& dgi_faults, const FaultProfile& desd_faults,
+             unsigned seed, const std::string& log_file)
+    : m_io_service(),
+      m_acceptor(m_io_service,
+                 boost::asio::ip::tcp::endpoint(
+                     boost::asio::ip::address_v4::loopback(), 0)),
+      m_master(m_io_service),
+      m_slave_fd(-1),
+      m_dgi_faults(dgi_faults),
+      m_seed(seed),
+      m_log_file(log_file),
+      m_recorder(),
+      m_desd(m_master, desd_faults, seed, m_recorder),
+      m_stop(false),
+      m_controller(-1),
+      m_watchdog_restarts(0),
+      m_exits(0),
+      m_elapsed(0)
+{
+    ::pthread_mutex_init(&m_mutex, 0);
+    SetCloseOnExec(m_acceptor.native_handle());
+
+    int master = ::posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || ::grantpt(master) != 0 || ::unlockpt(master) != 0)
+        throw std::runtime_error("Failed to create pseudoterminal");
+    SetCloseOnExec(master);
+    m_master.assign(master);
+    m_slave_name = ::ptsname(master);
+
+    m_slave_fd = ::open(m_slave_name.c_str(), O_RDWR | O_NOCTTY);
+    if (m_slave_fd < 0)
+        throw std::runtime_error("Failed to open " + m_slave_name);
+    SetCloseOnExec(m_slave_fd);
+
+    // Otherwise the line discipline echoes the DESD's replies back to it
+    termios settings;
+    ::tcgetattr(m_slave_fd, &settings);
+    ::cfmakeraw(&settings);
+    ::tcsetattr(m_slave_fd, TCSANOW, &settings);
+
+    std::ofstream truncate(m_log_file.c_str());
+}
+
+Bench::~Bench()
+{
+    KillController();
+    if (m_slave_fd >= 0)
+        ::close(m_slave_fd);
+    ::pthread_mutex_destroy(&m_mutex);
+}
+
+/**
+ * @param cycles stop after this many cycles complete
+ * @param watchdog restart the controller after this many seconds without a
+ *        completed cycle
+ * @param time_limit stop after this many seconds regardless
+ */
+void Bench::Run(unsigned cycles, double watchdog, double time_limit)
+{
+    pthread_t dgi_thread, desd_thread;
+    ::pthread_create(&dgi_thread, 0, &Bench::ServeDgiThread, this);
+    ::pthread_create(&desd_thread, 0, &Bench::ServeDesdThread, this);
+
+    double start = MonotonicSeconds();
+    SpawnController();
+    while (m_recorder.Cycles() < cycles &&
+           MonotonicSeconds() - start < time_limit)
+    {
+        ::usleep(20000);
+
+        int status;
+        if (::waitpid(m_controller, &status, WNOHANG) == m_controller)
+        {
+            m_controller = -1;
+            m_exits++;
+            SpawnController();
+        }
+        else if (MonotonicSeconds() - m_recorder.LastProgress() > watchdog)
+        {
+            KillController();
+            m_watchdog_restarts++;
+            SpawnController();
+        }
+    }
+    m_elapsed = MonotonicSeconds() - start;
+
+    {
+        ScopedLock lock(m_mutex);
+        m_stop = true;
+    }
+    m_desd.Stop();
+    // Killing the controller breaks any session the DGI thread is blocked in
+    KillController();
+    ::pthread_join(dgi_thread, 0);
+    ::pthread_join(desd_thread, 0);
+}
+
+/**
+ * @param os where to print the results
+ */
+void Bench::Report(std::ostream& os)
+{
+    os << "  " << m_recorder.Cycles() << " cycles in " << std::fixed
+       << std::setprecision(2) << m_elapsed << " s, "
+       << m_watchdog_restarts << " watchdog restarts, "
+       << m_exits << " controller exits\n";
+    os << "  " << CountLines(m_log_file, "Confused the DESD")
+       << " \"Confused the DESD\", "
+       << CountLines(m_log_file, "Confused the DGI") << " BadRequest, "
+       << CountLines(m_log_file, "Reconnecting after error")
+       << " reconnects\n";
+    m_recorder.Report(os);
+}
+
+void* Bench::ServeDgiThread(void* bench)
+{
+    static_cast<Bench*>(bench)->ServeDgi();
+    return 0;
+}
+
+void* Bench::ServeDesdThread(void* bench)
+{
+    static_cast<Bench*>(bench)->m_desd.Run();
+    return 0;
+}
+
+void Bench::ServeDgi()
+{
+    for (unsigned session = 0; !Stopping(); )
+    {
+        if (!WaitReadable(m_acceptor.native_handle(), 100))
+            continue;
+
+        boost::asio::ip::tcp::socket socket(m_io_service);
+        m_acceptor.accept(socket);
+        SetCloseOnExec(socket.native_handle());
+
+        try
+        {
+            FakeDgi dgi(socket, m_dgi_faults, m_seed + ++session, m_recorder);
+            dgi.Serve();
+        }
+        catch (std::exception& e)
+        {
+            // The session is over; wait for the controller to reconnect
+        }
+    }
+}
+
+bool Bench::Stopping()
+{
+    ScopedLock lock(m_mutex);
+    return m_stop;
+}
+
+/**
+ * Starts the controller by re-executing this program in controller mode, with
+ * its output appended to the log file.
+ *
+ * @ErrorHandling throws std::runtime_error if fork fails
+ */
+void Bench::SpawnController()
+{
+    // Everything the child needs is prepared before fork, because the child
+    // of a multithreaded process may only make async-signal-safe calls
+    std::string port =
+        boost::lexical_cast<std::string>(m_acceptor.local_endpoint().port());
+    const char* log_file = m_log_file.c_str();
+
+    m_desd.Reset();
+    m_recorder.Touch();
+
+    m_controller = ::fork();
+    if (m_controller < 0)
+        throw std::runtime_error("Failed to start the controller");
+    if (m_controller == 0)
+    {
+        int fd = ::open(log_file, O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (fd >= 0)
+        {
+            ::dup2(fd, STDOUT_FILENO);
+            ::dup2(fd, STDERR_FILENO);
+        }
+        ::signal(SIGPIPE, SIG_DFL);
+        ::execl("/proc/self/exe", "desd-bench", "--controller",
+                "--dgi-port", port.c_str(),
+                "--serial-port", m_slave_name.c_str(),
+                static_cast<char*>(0));
+        ::_exit(127);
+    }
+}
+
+void Bench::KillController()
+{
+    if (m_controller > 0)
+    {
+        ::kill(m_controller, SIGKILL);
+        ::waitpid(m_controller, 0, 0);
+        m_controller = -1;
+    }
+}
+
+/**
+ * A named pair of fault profiles for the DGI and DESD links.
+ */
+struct NamedProfile
+{
+    /// Name used on the command line
+    std::string name;
+    /// Faults on the DGI link
+    FaultProfile dgi;
+    /// Faults on the DESD link
+    FaultProfile desd;
+};
+
+/**
+ * @return the built-in profiles, in the order they are run by "all"
+ */
+std::vector<NamedProfile> BuiltinProfiles()
+{
+    std::vector<NamedProfile> profiles;
+    NamedProfile p;
+
+    p.name = "clean";
+    profiles.push_back(p);
+
+    p = NamedProfile();
+    p.name = "latency";
+    p.dgi.latency_min_us = p.desd.latency_min_us = 200;
+    p.dgi.latency_max_us = p.desd.latency_max_us = 2000;
+    p.dgi.tail_probability = p.desd.tail_probability = 0.01;
+    p.dgi.tail_latency_us = p.desd.tail_latency_us = 50000;
+    profiles.push_back(p);
+
+    p = NamedProfile();
+    p.name = "fragment";
+    // The simulators' short writes are what fragment the controller's reads;
+    // partial reads would only fragment the simulators' own
+    p.dgi.short_write_probability = p.desd.short_write_probability = 0.5;
+    p.dgi.latency_max_us = p.desd.latency_max_us = 500;
+    profiles.push_back(p);
+
+    p = NamedProfile();
+    p.name = "corrupt";
+    p.dgi.corruption_probability = p.desd.corruption_probability = 0.002;
+    profiles.push_back(p);
+
+    p = NamedProfile();
+    p.name = "stall";
+    p.dgi.stall_probability = p.desd.stall_probability = 0.005;
+    p.dgi.stall_us = p.desd.stall_us = 1500000;
+    profiles.push_back(p);
+
+    p = NamedProfile();
+    p.name = "disconnect";
+    p.dgi.disconnect_probability = p.desd.disconnect_probability = 0.002;
+    profiles.push_back(p);
+
+    p = NamedProfile();
+    p.name = "mixed";
+    p.dgi.latency_min_us = p.desd.latency_min_us = 200;
+    p.dgi.latency_max_us = p.desd.latency_max_us = 2000;
+    p.dgi.tail_probability = p.desd.tail_probability = 0.005;
+    p.dgi.tail_latency_us = p.desd.tail_latency_us = 50000;
+    p.dgi.short_write_probability = p.desd.short_write_probability = 0.2;
+    p.dgi.corruption_probability = p.desd.corruption_probability = 0.0005;
+    p.dgi.stall_probability = p.desd.stall_probability = 0.001;
+    p.dgi.stall_us = p.desd.stall_us = 1500000;
+    p.dgi.disconnect_probability = p.desd.disconnect_probability = 0.0005;
+    profiles.push_back(p);
+
+    return profiles;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    po::options_description od("Options");
+    po::options_description hidden;
+    po::variables_map vm;
+    std::string profile_name, log_file, port, serial_port;
+    unsigned cycles, seed;
+    double watchdog, time_limit;
+
+    od.add_options()
+        ("profile,P",
+         po::value<std::string>(&profile_name)->default_value("all"),
+         "fault profile: clean, latency, fragment, corrupt, stall, "
+         "disconnect, mixed, or all")
+        ("cycles,n", po::value<unsigned>(&cycles)->default_value(2000),
+         "cycles to complete per profile")
+        ("time-limit", po::value<double>(&time_limit)->default_value(120),
+         "seconds to run each profile at most")
+        ("watchdog", po::value<double>(&watchdog)->default_value(3),
+         "seconds without a cycle before the controller is restarted")
+        ("seed", po::value<unsigned>(&seed)->default_value(1),
+         "seed for the fault generators")
+        ("log-file",
+         po::value<std::string>(&log_file)->default_value("desd-bench.log"),
+         "where to write the controller's output")
+        ("help,h", "print help");
+    // Used when the benchmark re-executes itself as the controller
+    hidden.add_options()
+        ("controller", "run the controller")
+        ("dgi-port", po::value<std::string>(&port), "")
+        ("serial-port", po::value<std::string>(&serial_port), "");
+
+    po::options_description all;
+    all.add(od).add(hidden);
+    po::store(po::command_line_parser(argc, argv).options(all).run(), vm);
+    po::notify(vm);
+
+    if (vm.count("help"))
+    {
+        std::cout << od << std::endl;
+        return 0;
+    }
+
+    if (vm.count("controller"))
+    {
+        DgiInterface dgi_interface("127.0.0.1", port, serial_port, 0);
+        dgi_interface.Run();
+    }
+
+    // Writes to a session the controller has abandoned must not kill us
+    ::signal(SIGPIPE, SIG_IGN);
+
+    std::vector<NamedProfile> profiles = BuiltinProfiles();
+    bool found = false;
+    for (std::size_t i = 0; i < profiles.size(); i++)
+    {
+        if (profile_name != "all" && profile_name != profiles[i].name)
+            continue;
+        found = true;
+
+        std::cout << "profile " << profiles[i].name << ":" << std::endl;
+        Bench bench(profiles[i].dgi, profiles[i].desd, seed, log_file);
+        bench.Run(cycles, watchdog, time_limit);
+        bench.Report(std::cout);
+        std::cout << std::endl;
+    }
+
+    if (!found)
+    {
+        std::cerr << "Unknown profile: " << profile_name << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,229 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-
+ *
+ *  desd-discovery.cpp
+ *
+ *  Author: desd-controller contributors
+ *
+ *  Modified version: this file is not part of the original desd-controller
+ *  sources by Michael Catanzaro <michael.catanzaro@mst.edu>.
+ *
+ *  These source code files were created at Missouri University of Science and
+ *  Technology, and are intended for use in teaching or research. They may be
+ *  freely copied, modified, and redistributed as long as modified versions are
+ *  clearly marked as such and this notice is not removed. Neither the authors
+ *  nor Missouri S&T make any warranty, express or implied, nor assume any legal
+ *  responsibility for the accuracy, completeness, or usefulness of these files
+ *  or any information distributed with these files.
+ *
+ *  Suggested modifications or questions about these files can be directed to
+ *  Dr. Bruce McMillin, Department of Computer Science, Missouri University of
+ *  Science and Technology, Rolla, MO 65409 <ff@mst.edu>.
+ */
+
+#include "desd-discovery.hpp"
+#include "desd-interface.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+#include <boost/asio/read_until.hpp>
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/system/system_error.hpp>
+#include <glob.h>
+#include <unistd.h>
+
+namespace {
+
+/// Where USB and on-board serial adapters show up
+const char* const candidate_patterns[] = {
+    "/dev/ttyUSB*", "/dev/ttyACM*", "/dev/ttyS*"
+};
+
+/// The end of the DESD's intro prompt
+const std::string prompt_end = "DESD";
+
+}
+
+DesdDiscovery::Probe::Probe(boost::asio::io_service& io_service,
+                            const std::string& name)
+    : name(name),
+      serial_port(io_service),
+      streambuf(),
+      found(false)
+{
+    DesdInterface::OpenSerialPort(serial_port, name);
+}
+
+/**
+ * Opens, locks and configures each candidate terminal. Terminals that cannot
+ * be opened or configured, e.g. on-board ports with no UART behind them, are
+ * skipped, as are terminals already in use by another controller, which are
+ * neither reconfigured nor flushed.
+ *
+ * @param candidates paths of the terminals to probe
+ */
+DesdDiscovery::DesdDiscovery(const std::vector<std::string>& candidates)
+    : m_io_service(),
+      m_deadline(m_io_service),
+      m_pending(0)
+{
+    for (std::size_t i = 0; i < candidates.size(); i++)
+    {
+        try
+        {
+            boost::shared_ptr<Probe> probe(
+                new Probe(m_io_service, candidates[i]));
+            DesdInterface::ConfigureSerialPort(probe->serial_port);
+            DesdInterface::FlushSerialPort(probe->serial_port);
+            m_probes.push_back(probe);
+        }
+        catch (boost::system::system_error& e)
+        {
+            std::cout << "Skipping " << candidates[i] << ": " << e.what()
+                      << std::endl;
+        }
+    }
+}
+
+/**
+ * Waits for the intro prompt on every terminal at once. Returns when every
+ * terminal has answered or failed, or when the timeout expires, whichever is
+ * first. Terminals that did not answer are closed.
+ *
+ * @param timeout_seconds bound on the whole discovery
+ */
+void DesdDiscovery::Run(unsigned timeout_seconds)
+{
+    std::cout << "Probing " << m_probes.size() << " serial terminals for DESDs"
+              << std::endl;
+
+    m_pending = m_probes.size();
+    if (m_pending == 0)
+        return;
+
+    for (std::size_t i = 0; i < m_probes.size(); i++)
+    {
+        boost::asio::async_read_until(m_probes[i]->serial_port,
+            m_probes[i]->streambuf, prompt_end,
+            boost::bind(&DesdDiscovery::HandlePrompt, this, i, _1));
+    }
+    m_deadline.expires_from_now(boost::posix_time::seconds(timeout_seconds));
+    m_deadline.async_wait(
+        boost::bind(&DesdDiscovery::HandleDeadline, this, _1));
+
+    m_io_service.run();
+
+    for (std::size_t i = 0; i < m_probes.size(); i++)
+    {
+        if (!m_probes[i]->found)
+            m_probes[i]->serial_port.close();
+    }
+}
+
+/**
+ * @return the terminals on which a DESD answered, in order by name
+ */
+std::vector<std::string> DesdDiscovery::Found() const
+{
+    std::vector<std::string> result;
+    for (std::size_t i = 0; i < m_probes.size(); i++)
+    {
+        if (m_probes[i]->found)
+            result.push_back(m_probes[i]->name);
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+/**
+ * Hands over an answering terminal, configured and with its intro prompt
+ * consumed, so the DESD does not have to introduce itself again. The
+ * returned descriptor keeps the terminal locked for as long as it is open.
+ *
+ * @ErrorHandling throws std::runtime_error if no DESD answered on terminal
+ *
+ * @param terminal one of the terminals returned by Found()
+ *
+ * @return an open descriptor for the terminal, owned by the caller
+ */
+int DesdDiscovery::Adopt(const std::string& terminal)
+{
+    for (std::size_t i = 0; i < m_probes.size(); i++)
+    {
+        Probe& probe = *m_probes[i];
+        if (probe.found && probe.name == terminal &&
+            probe.serial_port.is_open())
+        {
+            // serial_port cannot release its descriptor, so duplicate it
+            int fd = ::dup(probe.serial_port.native_handle());
+            if (fd < 0)
+                throw std::runtime_error("Failed to adopt " + terminal);
+            probe.serial_port.close();
+            return fd;
+        }
+    }
+    throw std::runtime_error("No DESD discovered on " + terminal);
+}
+
+/**
+ * @return the existing USB and on-board serial terminals
+ */
+std::vector<std::string> DesdDiscovery::DefaultCandidates()
+{
+    std::vector<std::string> result;
+    const std::size_t count =
+        sizeof(candidate_patterns) / sizeof(candidate_patterns[0]);
+
+    for (std::size_t i = 0; i < count; i++)
+    {
+        glob_t matches;
+        if (::glob(candidate_patterns[i], 0, 0, &matches) == 0)
+        {
+            for (std::size_t j = 0; j < matches.gl_pathc; j++)
+                result.push_back(matches.gl_pathv[j]);
+        }
+        ::globfree(&matches);
+    }
+
+    return result;
+}
+
+/**
+ * @param probe index of the probe whose read finished
+ * @param e why the read finished
+ */
+void DesdDiscovery::HandlePrompt(std::size_t probe,
+                                 const boost::system::error_code& e)
+{
+    if (!e)
+    {
+        m_probes[probe]->found = true;
+        std::cout << "Found DESD on " << m_probes[probe]->name << std::endl;
+    }
+    else if (e != boost::asio::error::operation_aborted)
+    {
+        std::cout << "No DESD on " << m_probes[probe]->name << ": "
+                  << e.message() << std::endl;
+    }
+
+    if (--m_pending == 0)
+        m_deadline.cancel();
+}
+
+/**
+ * @param e operation_aborted if every terminal finished before the deadline
+ */
+void DesdDiscovery::HandleDeadline(const boost::system::error_code& e)
+{
+    if (e != boost::asio::error::operation_aborted)
+    {
+        std::cout << "DESD discovery timed out" << std::endl;
+        for (std::size_t i = 0; i < m_probes.size(); i++)
+        {
+            if (!m_probes[i]->found)
+                m_probes[i]->serial_port.cancel();
+        }
+    }
+}
@@ -0,0 +1,84 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-
+ *
+ *  desd-discovery.hpp
+ *
+ *  Author: desd-controller contributors
+ *
+ *  Modified version: this file is not part of the original desd-controller
+ *  sources by Michael Catanzaro <michael.catanzaro@mst.edu>.
+ *
+ *  These source code files were created at Missouri University of Science and
+ *  Technology, and are intended for use in teaching or research. They may be
+ *  freely copied, modified, and redistributed as long as modified versions are
+ *  clearly marked as such and this notice is not removed. Neither the authors
+ *  nor Missouri S&T make any warranty, express or implied, nor assume any legal
+ *  responsibility for the accuracy, completeness, or usefulness of these files
+ *  or any information distributed with these files.
+ *
+ *  Suggested modifications or questions about these files can be directed to
+ *  Dr. Bruce McMillin, Department of Computer Science, Missouri University of
+ *  Science and Technology, Rolla, MO 65409 <ff@mst.edu>.
+ */
+
+#ifndef DESD_DISCOVERY_HPP
+#define DESD_DISCOVERY_HPP
+
+#include <string>
+#include <vector>
+
+#include <boost/asio/deadline_timer.hpp>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/serial_port.hpp>
+#include <boost/asio/streambuf.hpp>
+#include <boost/shared_ptr.hpp>
+
+/**
+ * Finds the serial terminals that have a DESD attached by opening all of them
+ * at once and waiting, in parallel, for the intro prompt each DESD sends.
+ */
+class DesdDiscovery
+{
+public:
+    /// Constructor
+    DesdDiscovery(const std::vector<std::string>& candidates);
+    /// Waits up to timeout_seconds for the DESDs to introduce themselves
+    void Run(unsigned timeout_seconds);
+    /// The terminals on which a DESD answered, in order by name
+    std::vector<std::string> Found() const;
+    /// Hands over an answering terminal's descriptor to the caller
+    int Adopt(const std::string& terminal);
+    /// Serial terminals that a DESD might be attached to
+    static std::vector<std::string> DefaultCandidates();
+
+private:
+    /// A terminal being probed
+    struct Probe
+    {
+        /// Constructor
+        Probe(boost::asio::io_service& io_service, const std::string& name);
+        /// Path of the terminal
+        std::string name;
+        /// The open terminal
+        boost::asio::serial_port serial_port;
+        /// Receives the intro prompt
+        boost::asio::streambuf streambuf;
+        /// Whether the intro prompt has been received
+        bool found;
+    };
+
+    /// Handles the end of the wait for one terminal's prompt
+    void HandlePrompt(std::size_t probe, const boost::system::error_code& e);
+    /// Gives up on the terminals that have not answered
+    void HandleDeadline(const boost::system::error_code& e);
+
+    /// Runs the reads and the deadline
+    boost::asio::io_service m_io_service;
+    /// Bounds the whole discovery
+    boost::asio::deadline_timer m_deadline;
+    /// Terminals that could be opened and configured
+    std::vector<boost::shared_ptr<Probe> > m_probes;
+    /// Number of probes still waiting for a prompt
+    std::size_t m_pending;
+};
+
+#endif
@@ -25,26 +25,48 @@
 #include <sstream>
 
 #include <boost/lexical_cast.hpp>
+#include <boost/system/system_error.hpp>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/file.h>
 #include <termios.h>
+#include <unistd.h>
 
 /**
- * Constructs a DesdInterface. Reads and discards the prompt it sends us.
+ * Constructs a DesdInterface. Reads and discards the prompt it sends us,
+ * unless given a terminal on which that has already been done.
  *
  * @param io_service the io_service to use for the serial connection
  * @param serial_port the name of the terminal to open (e.g. /dev/ttyS0)
+ * @param fd an open, configured and locked descriptor for serial_port whose
+ *        prompt has already been read, e.g. by DesdDiscovery, or -1 to open
+ *        serial_port
+ * @param timeline where to record the timing of every byte exchanged with the
+ *        DESD, or null to record nothing
  */
 DesdInterface::DesdInterface(boost::asio::io_service& io_service,
-                             std::string serial_port)
-    : IOInterface(m_serial_port),
-      m_serial_port(io_service, serial_port)
+                             std::string serial_port, int fd,
+                             SerialTimeline* timeline)
+    : IOInterface(m_stream),
+      m_serial_port(io_service),
+      m_stream(m_serial_port, timeline)
 {
-    ConfigureSerialPort();
-    FlushSerialPort();
+    if (fd >= 0)
+    {
+        std::cout << "Using DESD discovered on " << serial_port << std::endl;
+        m_serial_port.assign(fd);
+    }
+    else
+    {
+        OpenSerialPort(m_serial_port, serial_port);
+        ConfigureSerialPort(m_serial_port);
+        FlushSerialPort(m_serial_port);
 
-    std::cout << "Discarding DESD's intro prompt" << std::endl;
-    // The end of the prompt is the string "DESD"
-    (void) ReadUntil('D');
-    (void) ReadUntil('D');
+        std::cout << "Discarding DESD's intro prompt" << std::endl;
+        // The end of the prompt is the string "DESD"
+        (void) ReadUntil('D');
+        (void) ReadUntil('D');
+    }
 
     Start();
 }
@@ -85,18 +107,23 @@ void DesdInterface::Stop()
  *
  * @ErrorHandling throws std::runtime_error if the state does not exist
  *
+ * @param verbose false to log nothing, e.g. when polling back to back
+ *
  * @return Watts
  */
-float DesdInterface::GetPowerLevel()
+float DesdInterface::GetPowerLevel(bool verbose)
 {
-    std::cout << "Sending a power state request" << std::endl;
-    Write("000000m");
+    if (verbose)
+        std::cout << "Sending a power state request" << std::endl;
+    Write("000000m", verbose);
 
-    std::cout << "Discarding DESD's state preamble" << std::endl;
-    (void) ReadUntil(':');
+    if (verbose)
+        std::cout << "Discarding DESD's state preamble" << std::endl;
+    (void) ReadUntil(':', verbose);
 
-    std::cout << "Reading DESD state response" << std::endl;
-    std::string response = ReadUntil('W');
+    if (verbose)
+        std::cout << "Reading DESD state response" << std::endl;
+    std::string response = ReadUntil('W', verbose);
     // cut off the W
     response.resize(response.length() - 1);
     // trim leading spaces
@@ -142,57 +169,120 @@ void DesdInterface::SetPowerLevel(float power_level)
 }
 
 /**
- * Configures the serial port with the settings expected by the DESD.
+ * Opens a serial terminal and takes an exclusive lock on it, so that no other
+ * controller, or DESD discovery, touches a terminal that is already in use.
+ * The lock is taken before the terminal is reconfigured, and is held until
+ * the last descriptor for it is closed, including duplicates. The terminal is
+ * put into raw mode, as serial_port::open would.
+ *
+ * @ErrorHandling throws boost::system::system_error if the terminal cannot be
+ * opened, is locked by another process, or is not a terminal
+ *
+ * @param serial_port a closed serial port
+ * @param terminal the name of the terminal to open (e.g. /dev/ttyS0)
  */
-void DesdInterface::ConfigureSerialPort()
+void DesdInterface::OpenSerialPort(boost::asio::serial_port& serial_port,
+                                   const std::string& terminal)
 {
-    m_serial_port.set_option(
+    int fd = ::open(terminal.c_str(), O_RDWR | O_NONBLOCK | O_NOCTTY);
+    if (fd < 0)
+    {
+        throw boost::system::system_error(errno,
+            boost::system::system_category(), terminal);
+    }
+
+    if (::flock(fd, LOCK_EX | LOCK_NB) != 0)
+    {
+        int error = errno;
+        ::close(fd);
+        throw boost::system::system_error(error,
+            boost::system::system_category(), terminal + " is in use");
+    }
+
+    termios ios;
+    if (::tcgetattr(fd, &ios) != 0)
+    {
+        int error = errno;
+        ::close(fd);
+        throw boost::system::system_error(error,
+            boost::system::system_category(), terminal);
+    }
+
+    ::cfmakeraw(&ios);
+    ios.c_cflag |= CREAD | CLOCAL;
+    if (::tcsetattr(fd, TCSANOW, &ios) != 0)
+    {
+        int error = errno;
+        ::close(fd);
+        throw boost::system::system_error(error,
+            boost::system::system_category(), terminal);
+    }
+
+    serial_port.assign(fd);
+}
+
+/**
+ * Configures a serial port with the settings expected by the DESD.
+ *
+ * @param serial_port an open serial port
+ */
+void DesdInterface::ConfigureSerialPort(boost::asio::serial_port& serial_port)
+{
+    serial_port.set_option(
         boost::asio::serial_port::baud_rate(9600));
-    m_serial_port.set_option(
+    serial_port.set_option(
         boost::asio::serial_port::flow_control(
             boost::asio::serial_port::flow_control::none));
-    m_serial_port.set_option(
+    serial_port.set_option(
         boost::asio::serial_port::parity(
             boost::asio::serial_port::parity::none));
-    m_serial_port.set_option(
+    serial_port.set_option(
         boost::asio::serial_port::stop_bits(
             boost::asio::serial_port::stop_bits::one));
-    m_serial_port.set_option(boost::asio::serial_port::character_size(8));
+    serial_port.set_option(boost::asio::serial_port::character_size(8));
 }
 
 /**
- * Flushes all data currently in the serial port buffer, out of an abundence of
+ * Flushes all data currently in a serial port buffer, out of an abundence of
  * caution. All incomplete I/O will be discarded.
+ *
+ * @param serial_port an open serial port
  */
-void DesdInterface::FlushSerialPort()
+void DesdInterface::FlushSerialPort(boost::asio::serial_port& serial_port)
 {
-    ::tcflush(m_serial_port.native_handle(), TCIOFLUSH);
+    ::tcflush(serial_port.native_handle(), TCIOFLUSH);
 }
 
 /**
  * Writes a command to the DESD
  *
  * @param command the command to write
+ * @param verbose false to log nothing
  */
-void DesdInterface::Write(std::string command)
+void DesdInterface::Write(std::string command, bool verbose)
 {
-    std::cout << "Writing to DESD: " << command << std::endl;
+    if (verbose)
+        std::cout << "Writing to DESD: " << command << std::endl;
     IOInterface::Write(command);
-    std::cout << "Write complete" << std::endl;
+    if (verbose)
+        std::cout << "Write complete" << std::endl;
 }
 
 /**
  * Reads a response from the DESD
  *
  * @param until character to read until (returned with result)
+ * @param verbose false to log nothing
  *
  * @return the DESD's response
  */
-std::string DesdInterface::ReadUntil(char until)
+std::string DesdInterface::ReadUntil(char until, bool verbose)
 {
-    std::cout << "Reading from DESD until: " << until << std::endl;
+    if (verbose)
+        std::cout << "Reading from DESD until: " << until << std::endl;
     std::string result = IOInterface::ReadUntil(until);
-    std::cout << "Read: " << result << std::endl;
+    if (verbose)
+        std::cout << "Read: " << result << std::endl;
 
     if (result.find("unrecognized command") != std::string::npos)
     {
@@ -21,6 +21,7 @@
 #define DESD_INTERFACE_HPP
 
 #include "io-interface.hpp"
+#include "serial-timeline.hpp"
 
 #include <string>
 
@@ -30,11 +31,13 @@
 /**
  * A class that knows how to talk to the DESD.
  */
-class DesdInterface : public IOInterface<boost::asio::serial_port>
+class DesdInterface
+    : public IOInterface<TimelineStream<boost::asio::serial_port> >
 {
 public:
     /// Constructor
-    DesdInterface(boost::asio::io_service& io_service, std::string serial_port);
+    DesdInterface(boost::asio::io_service& io_service, std::string serial_port,
+                  int fd = -1, SerialTimeline* timeline = 0);
     /// Destructor
     ~DesdInterface();
     /// Start the DESD's current injection
@@ -42,22 +45,27 @@ public:
     /// Stop the DESD's current injection
     void Stop();
     /// Get the power level of the DESD
-    float GetPowerLevel();
+    float GetPowerLevel(bool verbose = true);
     /// Change the power level of the DESD
     void SetPowerLevel(float power_level);
+    /// Opens a serial terminal for exclusive use
+    static void OpenSerialPort(boost::asio::serial_port& serial_port,
+                               const std::string& terminal);
+    /// Configures a serial port with the settings expected by the DESD
+    static void ConfigureSerialPort(boost::asio::serial_port& serial_port);
+    /// Flush all data currently in a serial port buffer
+    static void FlushSerialPort(boost::asio::serial_port& serial_port);
 
 private:
-    /// Configures the serial port with the correct settings
-    void ConfigureSerialPort();
-    /// Flush all data currently in the serial port buffer
-    void FlushSerialPort();
     /// Reads from the DESD up through until
-    std::string ReadUntil(char until);
+    std::string ReadUntil(char until, bool verbose = true);
     /// Writes to the DESD
-    void Write(std::string command);
+    void Write(std::string command, bool verbose = true);
 
     /// Serial terminal connected to the DESD
     boost::asio::serial_port m_serial_port;
+    /// The serial terminal, with optional byte timing capture
+    TimelineStream<boost::asio::serial_port> m_stream;
 };
 
 #endif
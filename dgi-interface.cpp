@@ -18,6 +18,7 @@
  */
 
 #include "dgi-interface.hpp"
+#include "monotonic-clock.hpp"
 
 #include <cmath>
 #include <cstring>
@@ -37,23 +38,59 @@ const std::string device_name = "DESD1";
 const std::string device_type = "Sst";
 const std::string device_signal = "gateway";
 
+/// Seconds to wait before reconnecting after an error
 const unsigned delay_seconds = 1;
 const float null_command = std::pow(10, 8);
 
+/**
+ * Formats one line of a DeviceStates message
+ *
+ * @param signal the signal name
+ * @param value the signal value
+ *
+ * @return the line, CRLF included
+ */
+std::string StateLine(const std::string& signal, float value)
+{
+    return device_name + " " + signal + " " +
+        boost::lexical_cast<std::string>(value) + "\r\n";
+}
+
 }
 
 /**
  * Constructs a DgiInterface.
+ *
+ * @param hostname the DGI to connect to
+ * @param port the DGI's plug and play port
+ * @param terminal the serial terminal connected to the DESD
+ * @param cycle_delay seconds to pause after sending states and after relaying
+ *        commands; zero runs the protocol as fast as the peers allow
+ * @param aggregate how the power levels sampled during the pauses are reduced
+ *        to the one reported to the DGI
+ * @param statistics_signals whether to report the mean, min, max, RMS, and
+ *        rate of change of the samples as additional signals
+ * @param terminal_fd an already discovered descriptor for the terminal, or -1
+ *        to open it by name
+ * @param timeline where to record the DESD's serial traffic, saved when a
+ *        signal stops the controller; may be null
  */
 DgiInterface::DgiInterface(std::string hostname, std::string port,
-                           std::string terminal)
+                           std::string terminal, unsigned cycle_delay,
+                           AggregatePolicy aggregate, bool statistics_signals,
+                           int terminal_fd, SerialTimeline* timeline)
     : IOInterface(m_socket),
       m_io_service(),
       m_hostname(hostname),
       m_port(port),
+      m_cycle_delay(cycle_delay),
+      m_aggregate(aggregate),
+      m_statistics_signals(statistics_signals),
+      m_samples(),
       m_socket(m_io_service),
       m_signal_set(m_io_service, SIGINT, SIGTERM),
-      m_desd_interface(m_io_service, terminal)
+      m_timeline(timeline),
+      m_desd_interface(m_io_service, terminal, terminal_fd, timeline)
 {
     m_signal_set.async_wait(
         boost::bind(&DgiInterface::CatchSignal, this, _1, _2));
@@ -117,14 +154,25 @@ void DgiInterface::Disconnect()
 }
 
 /**
- * Cleanly disconnects from the DGI and stops the DESD.
+ * Saves the serial timeline if there is one, then cleanly disconnects from the
+ * DGI and stops the DESD. The signal is re-raised even if the DESD cannot be
+ * stopped, e.g. because the serial link has failed.
  */
 void DgiInterface::CatchSignal(const boost::system::error_code& e, int signum)
 {
     if (e != boost::asio::error::operation_aborted)
     {
+        if (m_timeline)
+            m_timeline->Save();
         Disconnect();
-        m_desd_interface.Stop();
+        try
+        {
+            m_desd_interface.Stop();
+        }
+        catch (std::exception& ex)
+        {
+            std::cerr << "Failed to stop the DESD:\n" << ex.what() << std::endl;
+        }
         m_signal_set.remove(signum);
         ::raise(signum);
     }
@@ -154,23 +202,40 @@ void DgiInterface::ReceiveStart()
         throw std::runtime_error("Received malformed start message");
     std::cout << "Received start message, starting..." << std::endl;
 
+    // Readings taken before a failure would skew this session's first report
+    m_samples.Clear();
+
     m_io_service.post(boost::bind(&DgiInterface::SendState, this));
 }
 
 /**
- * Sends the DESD's power level to the DGI.
+ * Sends the DESD's power level to the DGI. The reported value is the
+ * aggregate of a fresh reading and any taken during the preceding pauses.
  */
 void DgiInterface::SendState()
 {
     std::cout << "Requesting power level from DESD..." << std::endl;
-    std::string power_level =
-        boost::lexical_cast<std::string>(m_desd_interface.GetPowerLevel());
-    std::cout << "Got power level from DESD, sending to DGI..." << std::endl;
-    Write("DeviceStates\r\n" +
-          device_name + " " + device_signal + " " + power_level + "\r\n");
+    float power_level = m_desd_interface.GetPowerLevel();
+    m_samples.Add(MonotonicSeconds(), power_level);
+    WindowStatistics stats = m_samples.Compute();
+    m_samples.Clear();
+
+    std::string states = StateLine(device_signal, stats.Aggregate(m_aggregate));
+    if (m_statistics_signals)
+    {
+        states += StateLine(device_signal + "_mean", stats.mean);
+        states += StateLine(device_signal + "_min", stats.min);
+        states += StateLine(device_signal + "_max", stats.max);
+        states += StateLine(device_signal + "_rms", stats.rms);
+        states += StateLine(device_signal + "_rate", stats.slope);
+    }
+
+    std::cout << "Got " << stats.count << " power levels from DESD, "
+              << "sending to DGI..." << std::endl;
+    Write("DeviceStates\r\n" + states);
     std::cout << "Successfully sent power level to DGI" << std::endl;
 
-    ::sleep(delay_seconds);
+    Pause();
     m_io_service.post(boost::bind(&DgiInterface::RelayCommand, this));
 }
 
@@ -209,10 +274,37 @@ void DgiInterface::RelayCommand()
         std::cout << "Dropping null command from DGI" << std::endl;
     }
 
-    ::sleep(delay_seconds);
+    Pause();
     m_io_service.post(boost::bind(&DgiInterface::SendState, this));
 }
 
+/**
+ * Waits for the cycle delay. If the DGI is to receive anything but the
+ * latest reading, the DESD is polled back to back for the whole delay, so
+ * the next state report covers fluctuations between cycles. The polls are not
+ * logged individually, which would flood the log and put console I/O between
+ * them.
+ */
+void DgiInterface::Pause()
+{
+    if (m_aggregate == AGGREGATE_LAST && !m_statistics_signals)
+    {
+        ::sleep(m_cycle_delay);
+        return;
+    }
+
+    std::cout << "Sampling power level from DESD..." << std::endl;
+    const double deadline = MonotonicSeconds() + m_cycle_delay;
+    unsigned polls = 0;
+    while (MonotonicSeconds() < deadline)
+    {
+        float power_level = m_desd_interface.GetPowerLevel(false);
+        m_samples.Add(MonotonicSeconds(), power_level);
+        polls++;
+    }
+    std::cout << "Took " << polls << " power level samples" << std::endl;
+}
+
 /**
  * Receives a message from the DGI.
  *
@@ -22,6 +22,8 @@
 
 #include "desd-interface.hpp"
 #include "io-interface.hpp"
+#include "sample-window.hpp"
+#include "serial-timeline.hpp"
 
 #include <string>
 
@@ -36,8 +38,16 @@
 class DgiInterface : public IOInterface<boost::asio::ip::tcp::socket>
 {
 public:
+    /// Seconds to pause between protocol steps unless told otherwise
+    static const unsigned DEFAULT_CYCLE_DELAY = 1;
+
     /// Constructor
-    DgiInterface(std::string hostname, std::string port, std::string terminal);
+    DgiInterface(std::string hostname, std::string port, std::string terminal,
+                 unsigned cycle_delay = DEFAULT_CYCLE_DELAY,
+                 AggregatePolicy aggregate = AGGREGATE_LAST,
+                 bool statistics_signals = false,
+                 int terminal_fd = -1,
+                 SerialTimeline* timeline = 0);
     /// Destructor
     ~DgiInterface();
     /// Runs the plug and play session protocol
@@ -58,6 +68,8 @@ private:
     void SendState();
     /// Sends the DGI's power level command to the DESD
     void RelayCommand();
+    /// Waits out the cycle delay, sampling the DESD if needed
+    void Pause();
     /// Process one message from the DGI
     std::string ReadMessage();
     /// Writes to the DESD
@@ -69,10 +81,20 @@ private:
     std::string m_hostname;
     /// Remote port to connect to
     std::string m_port;
+    /// Seconds to pause between protocol steps
+    unsigned m_cycle_delay;
+    /// How the sample window is reduced to the reported power level
+    AggregatePolicy m_aggregate;
+    /// Whether to report the window statistics as additional signals
+    bool m_statistics_signals;
+    /// DESD power levels sampled since the last state report
+    SampleWindow m_samples;
     /// Connected to the DGI
     boost::asio::ip::tcp::socket m_socket;
     /// Handles SIGINT, SIGTERM cleanly
     boost::asio::signal_set m_signal_set;
+    /// Records the DESD's serial traffic, may be null
+    SerialTimeline* m_timeline;
     /// Serial interface to the attached DESD
     DesdInterface m_desd_interface;
 };
@@ -0,0 +1,395 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-
+ *
+ *  fault-stream.hpp
+ *
+ *  Author: desd-controller contributors
+ *
+ *  Modified version: this file is not part of the original desd-controller
+ *  sources by Michael Catanzaro <michael.catanzaro@mst.edu>.
+ *
+ *  These source code files were created at Missouri University of Science and
+ *  Technology, and are intended for use in teaching or research. They may be
+ *  freely copied, modified, and redistributed as long as modified versions are
+ *  clearly marked as such and this notice is not removed. Neither the authors
+ *  nor Missouri S&T make any warranty, express or implied, nor assume any legal
+ *  responsibility for the accuracy, completeness, or usefulness of these files
+ *  or any information distributed with these files.
+ *
+ *  Suggested modifications or questions about these files can be directed to
+ *  Dr. Bruce McMillin, Department of Computer Science, Missouri University of
+ *  Science and Technology, Rolla, MO 65409 <ff@mst.edu>.
+ */
+
+#ifndef FAULT_STREAM_HPP
+#define FAULT_STREAM_HPP
+
+#include <cerrno>
+#include <cstddef>
+#include <ctime>
+#include <string>
+
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int_distribution.hpp>
+#include <boost/random/uniform_real_distribution.hpp>
+#include <boost/system/error_code.hpp>
+#include <boost/system/system_error.hpp>
+#include <boost/throw_exception.hpp>
+
+/// The kinds of misbehavior a FaultStream knows how to inject
+enum FaultClass
+{
+    FAULT_LATENCY,
+    FAULT_PARTIAL_READ,
+    FAULT_SHORT_WRITE,
+    FAULT_CORRUPTION,
+    FAULT_STALL,
+    FAULT_DISCONNECT,
+    FAULT_CLASS_COUNT
+};
+
+/**
+ * Returns a human-readable name for a fault class
+ *
+ * @param fault the fault class
+ *
+ * @return name of the fault class
+ */
+inline const char* FaultName(FaultClass fault)
+{
+    static const char* const names[FAULT_CLASS_COUNT] = {
+        "latency", "partial-read", "short-write",
+        "corruption", "stall", "disconnect"
+    };
+    return fault < FAULT_CLASS_COUNT ? names[fault] : "unknown";
+}
+
+/**
+ * Describes which faults a FaultStream injects and how often. Probabilities
+ * are per I/O operation, except corruption_probability, which is per byte.
+ * A default-constructed profile injects nothing.
+ */
+struct FaultProfile
+{
+    /// Constructor
+    FaultProfile()
+        : latency_min_us(0),
+          latency_max_us(0),
+          tail_probability(0),
+          tail_latency_us(0),
+          partial_read_probability(0),
+          short_write_probability(0),
+          corruption_probability(0),
+          stall_probability(0),
+          stall_us(0),
+          disconnect_probability(0)
+    {
+    }
+
+    /// Lower bound of the uniform delay added to every operation
+    unsigned latency_min_us;
+    /// Upper bound of the uniform delay added to every operation
+    unsigned latency_max_us;
+    /// Chance that an operation additionally suffers a latency spike
+    double tail_probability;
+    /// Length of a latency spike
+    unsigned tail_latency_us;
+    /// Chance that a read returns fewer bytes than it could have
+    double partial_read_probability;
+    /// Chance that a write accepts fewer bytes than it was given
+    double short_write_probability;
+    /// Chance that any single byte read or written is garbled
+    double corruption_probability;
+    /// Chance that an operation hangs silently before doing anything
+    double stall_probability;
+    /// Length of a silent stall
+    unsigned stall_us;
+    /// Chance that the link drops; every later operation fails too
+    double disconnect_probability;
+};
+
+/**
+ * Notified each time a FaultStream injects a fault.
+ */
+class FaultListener
+{
+public:
+    /// Destructor
+    virtual ~FaultListener() {}
+    /// Called just as the fault is injected
+    virtual void OnFault(FaultClass fault) = 0;
+};
+
+/**
+ * A decorator for a synchronous stream that injects faults according to a
+ * FaultProfile. It models the SyncReadStream and SyncWriteStream concepts, so
+ * it can be used in place of a serial_port or tcp::socket, e.g. as the stream
+ * of an IOInterface.
+ */
+template <typename Stream>
+class FaultStream
+{
+public:
+    /**
+     * Constructor
+     *
+     * @param next the stream to perform the actual I/O on
+     * @param profile the faults to inject
+     * @param seed seed for the fault generator, for reproducible runs
+     * @param listener notified of every injected fault, may be null
+     */
+    FaultStream(Stream& next, const FaultProfile& profile,
+                unsigned seed = 5489u, FaultListener* listener = 0)
+        : m_next(next),
+          m_profile(profile),
+          m_rng(seed),
+          m_listener(listener),
+          m_disconnected(false)
+    {
+    }
+
+    /**
+     * @return the decorated stream
+     */
+    Stream& next_layer()
+    {
+        return m_next;
+    }
+
+    /**
+     * Reads some data from the stream, possibly with faults
+     *
+     * @ErrorHandling throws boost::system::system_error on failure
+     *
+     * @param buffers where to put the data
+     *
+     * @return number of bytes read
+     */
+    template <typename MutableBufferSequence>
+    std::size_t read_some(const MutableBufferSequence& buffers)
+    {
+        boost::system::error_code ec;
+        std::size_t result = read_some(buffers, ec);
+        if (ec)
+            boost::throw_exception(boost::system::system_error(ec));
+        return result;
+    }
+
+    /**
+     * Reads some data from the stream, possibly with faults
+     *
+     * @param buffers where to put the data
+     * @param ec set to indicate what error occurred, if any
+     *
+     * @return number of bytes read
+     */
+    template <typename MutableBufferSequence>
+    std::size_t read_some(const MutableBufferSequence& buffers,
+                          boost::system::error_code& ec)
+    {
+        if (!BeginOperation(ec))
+            return 0;
+
+        // Reading into just the first buffer is a legitimate short read
+        boost::asio::mutable_buffer buffer = *buffers.begin();
+        char* data = boost::asio::buffer_cast<char*>(buffer);
+        std::size_t size = boost::asio::buffer_size(buffer);
+
+        if (size > 1 && Inject(m_profile.partial_read_probability,
+                               FAULT_PARTIAL_READ))
+        {
+            size = RandomSize(size - 1);
+        }
+
+        std::size_t result =
+            m_next.read_some(boost::asio::buffer(data, size), ec);
+        Corrupt(data, result);
+
+        return result;
+    }
+
+    /**
+     * Writes some data to the stream, possibly with faults
+     *
+     * @ErrorHandling throws boost::system::system_error on failure
+     *
+     * @param buffers the data to write
+     *
+     * @return number of bytes written
+     */
+    template <typename ConstBufferSequence>
+    std::size_t write_some(const ConstBufferSequence& buffers)
+    {
+        boost::system::error_code ec;
+        std::size_t result = write_some(buffers, ec);
+        if (ec)
+            boost::throw_exception(boost::system::system_error(ec));
+        return result;
+    }
+
+    /**
+     * Writes some data to the stream, possibly with faults
+     *
+     * @param buffers the data to write
+     * @param ec set to indicate what error occurred, if any
+     *
+     * @return number of bytes written
+     */
+    template <typename ConstBufferSequence>
+    std::size_t write_some(const ConstBufferSequence& buffers,
+                           boost::system::error_code& ec)
+    {
+        if (!BeginOperation(ec))
+            return 0;
+
+        // Writing just the first buffer is a legitimate short write
+        boost::asio::const_buffer buffer = *buffers.begin();
+        const char* data = boost::asio::buffer_cast<const char*>(buffer);
+        std::size_t size = boost::asio::buffer_size(buffer);
+
+        if (size > 1 && Inject(m_profile.short_write_probability,
+                               FAULT_SHORT_WRITE))
+        {
+            size = RandomSize(size - 1);
+        }
+
+        if (m_profile.corruption_probability > 0)
+        {
+            // The caller's data is const, so garble a copy
+            std::string copy(data, size);
+            Corrupt(&copy[0], size);
+            return m_next.write_some(boost::asio::buffer(copy), ec);
+        }
+
+        return m_next.write_some(boost::asio::buffer(data, size), ec);
+    }
+
+private:
+    /**
+     * Applies the faults common to reads and writes: disconnects, stalls, and
+     * latency.
+     *
+     * @param ec set if the link is down
+     *
+     * @return false if the operation must fail without doing any I/O
+     */
+    bool BeginOperation(boost::system::error_code& ec)
+    {
+        if (!m_disconnected &&
+            Inject(m_profile.disconnect_probability, FAULT_DISCONNECT))
+        {
+            m_disconnected = true;
+        }
+        if (m_disconnected)
+        {
+            ec = boost::asio::error::connection_reset;
+            return false;
+        }
+
+        if (Inject(m_profile.stall_probability, FAULT_STALL))
+            Sleep(m_profile.stall_us);
+
+        unsigned long delay = m_profile.latency_min_us;
+        if (m_profile.latency_max_us > m_profile.latency_min_us)
+        {
+            delay += static_cast<unsigned long>(Random() *
+                (m_profile.latency_max_us - m_profile.latency_min_us));
+        }
+        if (Inject(m_profile.tail_probability, FAULT_LATENCY))
+            delay += m_profile.tail_latency_us;
+        Sleep(delay);
+
+        ec = boost::system::error_code();
+        return true;
+    }
+
+    /**
+     * Garbles each byte of a buffer with probability corruption_probability
+     *
+     * @param data the buffer
+     * @param size the number of bytes in the buffer
+     */
+    void Corrupt(char* data, std::size_t size)
+    {
+        if (m_profile.corruption_probability <= 0)
+            return;
+
+        for (std::size_t i = 0; i < size; i++)
+        {
+            if (Inject(m_profile.corruption_probability, FAULT_CORRUPTION))
+            {
+                // XOR with a nonzero mask so the byte always changes
+                data[i] ^= static_cast<char>(RandomSize(255));
+            }
+        }
+    }
+
+    /**
+     * Decides whether to inject a fault, and notifies the listener if so
+     *
+     * @param probability chance of injecting the fault
+     * @param fault the class of fault
+     *
+     * @return true if the fault should be injected
+     */
+    bool Inject(double probability, FaultClass fault)
+    {
+        if (probability <= 0 || Random() >= probability)
+            return false;
+        if (m_listener)
+            m_listener->OnFault(fault);
+        return true;
+    }
+
+    /**
+     * @return a uniformly distributed number in [0, 1)
+     */
+    double Random()
+    {
+        return boost::random::uniform_real_distribution<double>(0, 1)(m_rng);
+    }
+
+    /**
+     * @param max the largest acceptable result
+     *
+     * @return a uniformly distributed number in [1, max]
+     */
+    std::size_t RandomSize(std::size_t max)
+    {
+        return boost::random::uniform_int_distribution<std::size_t>(1, max)(
+            m_rng);
+    }
+
+    /**
+     * Blocks the calling thread
+     *
+     * @param us microseconds to block for
+     */
+    static void Sleep(unsigned long us)
+    {
+        if (us == 0)
+            return;
+
+        timespec duration;
+        duration.tv_sec = us / 1000000;
+        duration.tv_nsec = (us % 1000000) * 1000;
+        while (::nanosleep(&duration, &duration) != 0 && errno == EINTR)
+        {
+            // interrupted by a signal, sleep for the remainder
+        }
+    }
+
+    /// The stream that performs the actual I/O
+    Stream& m_next;
+    /// Which faults to inject
+    FaultProfile m_profile;
+    /// Decides when to inject faults
+    boost::random::mt19937 m_rng;
+    /// Notified of injected faults, may be null
+    FaultListener* m_listener;
+    /// Whether a disconnect has been injected
+    bool m_disconnected;
+};
+
+#endif
@@ -17,19 +17,35 @@
  *  Science and Technology, Rolla, MO 65409 <ff@mst.edu>.
  */
 
+#include "desd-discovery.hpp"
 #include "dgi-interface.hpp"
+#include "realtime.hpp"
 
 #include <iostream>
+#include <stdexcept>
 
 #include <boost/program_options.hpp>
+#include <boost/scoped_ptr.hpp>
 
 namespace po = boost::program_options;
 
+namespace {
+
+/// Wakeups measured by each half of the jitter self-test
+const unsigned jitter_samples = 5000;
+/// Microseconds between wakeups in the jitter self-test
+const unsigned jitter_period_us = 1000;
+
+}
+
 int main(int argc, char* argv[])
 {
     po::options_description od;
     po::variables_map vm;
-    std::string hostname, port, serial_port;
+    std::string hostname, port, serial_port, aggregate, timeline_file;
+    int rt_priority, rt_cpu;
+    unsigned discover_timeout;
+    std::size_t timeline_capacity;
 
     od.add_options()
         ("dgi-address,a",
@@ -41,6 +57,39 @@ int main(int argc, char* argv[])
         ("serial-port,t",
          po::value<std::string>(&serial_port)->default_value("/dev/ttyS0"),
          "serial terminal connected to DESD")
+        ("discover,d",
+         "probe all serial terminals at once and use the one a DESD answers "
+         "on, instead of --serial-port")
+        ("discover-timeout",
+         po::value<unsigned>(&discover_timeout)->default_value(5),
+         "seconds to wait for DESDs to answer during discovery")
+        ("aggregate",
+         po::value<std::string>(&aggregate)->default_value("last"),
+         "power level reported to the DGI: last, mean, min, max, or rms of "
+         "the readings taken since the previous report")
+        ("statistics-signals",
+         "also report mean, min, max, rms, and rate of change of the readings "
+         "as extra signals (not understood by DGI 1.6)")
+        ("serial-timeline",
+         po::value<std::string>(&timeline_file),
+         "record when each byte crosses the DESD's serial line, and save the "
+         "timeline to this file on exit (Chrome trace JSON if it ends in "
+         ".json, else CSV)")
+        ("timeline-capacity",
+         po::value<std::size_t>(&timeline_capacity)->default_value(100000),
+         "serial timeline events to keep: one per byte plus one per write, "
+         "about 24 bytes each, allocated up front and locked in memory with "
+         "--realtime; later events are dropped")
+        ("realtime,r",
+         "lock memory, pin to a CPU, and use real-time scheduling")
+        ("rt-priority",
+         po::value<int>(&rt_priority)->default_value(50),
+         "SCHED_FIFO priority in real-time mode")
+        ("rt-cpu",
+         po::value<int>(&rt_cpu)->default_value(-1),
+         "CPU to pin to in real-time mode, or -1 for any")
+        ("jitter-test",
+         "measure wakeup latency with and without real-time mode, then exit")
         ("help,h", "print help");
 
     po::store(po::command_line_parser(argc, argv).options(od).run(), vm);
@@ -52,6 +101,64 @@ int main(int argc, char* argv[])
         return 0;
     }
 
-    DgiInterface dgi_interface(hostname, port, serial_port);
+    // Before any slow setup, such as discovery, that a typo would waste
+    AggregatePolicy aggregate_policy;
+    try
+    {
+        aggregate_policy = ParseAggregatePolicy(aggregate);
+    }
+    catch (std::runtime_error& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    if (vm.count("jitter-test"))
+    {
+        std::cout << "Normal mode: "
+                  << MeasureWakeupJitter(jitter_samples, jitter_period_us)
+                  << std::endl;
+        EnterRealtimeMode(rt_priority, rt_cpu);
+        std::cout << "Real-time mode: "
+                  << MeasureWakeupJitter(jitter_samples, jitter_period_us)
+                  << std::endl;
+        return 0;
+    }
+
+    int serial_fd = -1;
+    if (vm.count("discover"))
+    {
+        DesdDiscovery discovery(DesdDiscovery::DefaultCandidates());
+        discovery.Run(discover_timeout);
+        std::vector<std::string> found = discovery.Found();
+        if (found.empty())
+        {
+            std::cerr << "No DESD found on any serial terminal" << std::endl;
+            return 1;
+        }
+
+        serial_port = found.front();
+        serial_fd = discovery.Adopt(serial_port);
+        for (std::size_t i = 1; i < found.size(); i++)
+        {
+            std::cout << "Ignoring DESD on " << found[i]
+                      << ", only one DESD per controller is supported"
+                      << std::endl;
+        }
+    }
+
+    // Before the interfaces allocate their buffers, so those get locked too
+    if (vm.count("realtime"))
+        EnterRealtimeMode(rt_priority, rt_cpu);
+
+    boost::scoped_ptr<SerialTimeline> timeline;
+    if (vm.count("serial-timeline"))
+        timeline.reset(new SerialTimeline(timeline_file, timeline_capacity));
+
+    DgiInterface dgi_interface(hostname, port, serial_port,
+                               DgiInterface::DEFAULT_CYCLE_DELAY,
+                               aggregate_policy,
+                               vm.count("statistics-signals") > 0,
+                               serial_fd, timeline.get());
     dgi_interface.Run();
 }
@@ -0,0 +1,41 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-
+ *
+ *  monotonic-clock.hpp
+ *
+ *  Author: desd-controller contributors
+ *
+ *  Modified version: this file is not part of the original desd-controller
+ *  sources by Michael Catanzaro <michael.catanzaro@mst.edu>.
+ *
+ *  These source code files were created at Missouri University of Science and
+ *  Technology, and are intended for use in teaching or research. They may be
+ *  freely copied, modified, and redistributed as long as modified versions are
+ *  clearly marked as such and this notice is not removed. Neither the authors
+ *  nor Missouri S&T make any warranty, express or implied, nor assume any legal
+ *  responsibility for the accuracy, completeness, or usefulness of these files
+ *  or any information distributed with these files.
+ *
+ *  Suggested modifications or questions about these files can be directed to
+ *  Dr. Bruce McMillin, Department of Computer Science, Missouri University of
+ *  Science and Technology, Rolla, MO 65409 <ff@mst.edu>.
+ */
+
+#ifndef MONOTONIC_CLOCK_HPP
+#define MONOTONIC_CLOCK_HPP
+
+#include <ctime>
+
+/**
+ * Reads the monotonic clock, which is unaffected by changes to the system
+ * time. Only differences between readings are meaningful.
+ *
+ * @return seconds on the monotonic clock
+ */
+inline double MonotonicSeconds()
+{
+    timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+#endif
@@ -0,0 +1,202 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-
+ *
+ *  realtime.cpp
+ *
+ *  Author: desd-controller contributors
+ *
+ *  Modified version: this file is not part of the original desd-controller
+ *  sources by Michael Catanzaro <michael.catanzaro@mst.edu>.
+ *
+ *  These source code files were created at Missouri University of Science and
+ *  Technology, and are intended for use in teaching or research. They may be
+ *  freely copied, modified, and redistributed as long as modified versions are
+ *  clearly marked as such and this notice is not removed. Neither the authors
+ *  nor Missouri S&T make any warranty, express or implied, nor assume any legal
+ *  responsibility for the accuracy, completeness, or usefulness of these files
+ *  or any information distributed with these files.
+ *
+ *  Suggested modifications or questions about these files can be directed to
+ *  Dr. Bruce McMillin, Department of Computer Science, Missouri University of
+ *  Science and Technology, Rolla, MO 65409 <ff@mst.edu>.
+ */
+
+#include "realtime.hpp"
+#include "monotonic-clock.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include <malloc.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+namespace {
+
+/// Stack the control loop may use without faulting in new pages
+const std::size_t prefault_stack_size = 256 * 1024;
+/// Heap the control loop may use without faulting in new pages
+const std::size_t prefault_heap_size = 1024 * 1024;
+
+/**
+ * Prints a warning that part of real-time mode could not be enabled
+ *
+ * @param what the part that failed
+ * @param error the errno value describing the failure
+ */
+void Warn(const char* what, int error)
+{
+    std::cerr << "Warning: failed to " << what << ": " << std::strerror(error)
+              << "; continuing without it" << std::endl;
+}
+
+/**
+ * Touches every page of a large stack frame, so that later calls do not
+ * page fault. Must not be inlined, or the frame would not be released.
+ */
+__attribute__((noinline)) void PrefaultStack()
+{
+    volatile char stack[prefault_stack_size];
+    for (std::size_t i = 0; i < prefault_stack_size; i += 4096)
+        stack[i] = 0;
+    (void) stack[0];
+}
+
+/**
+ * Keeps freed heap memory in the process and faults in enough of it for the
+ * I/O buffers, so that allocations in the control loop do not page fault.
+ */
+void PrefaultHeap()
+{
+    // Never return memory to the kernel, and never satisfy malloc with mmap
+    ::mallopt(M_TRIM_THRESHOLD, -1);
+    ::mallopt(M_MMAP_MAX, 0);
+
+    char* heap = static_cast<char*>(std::malloc(prefault_heap_size));
+    if (heap)
+    {
+        std::memset(heap, 0, prefault_heap_size);
+        std::free(heap);
+    }
+}
+
+}
+
+/**
+ * Puts the calling thread into real-time execution mode: locks all current
+ * and future memory, prefaults the stack and heap, pins the thread to a CPU,
+ * and switches it to SCHED_FIFO. Each step that fails, usually for lack of
+ * privileges, is skipped with a warning.
+ *
+ * @param priority the SCHED_FIFO priority
+ * @param cpu the CPU to pin to, or negative to leave affinity alone
+ *
+ * @return true if every step succeeded
+ */
+bool EnterRealtimeMode(int priority, int cpu)
+{
+    bool complete = true;
+
+    if (::mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+    {
+        Warn("lock memory", errno);
+        complete = false;
+    }
+    PrefaultStack();
+    PrefaultHeap();
+
+    if (cpu >= 0)
+    {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu, &cpus);
+        if (::sched_setaffinity(0, sizeof(cpus), &cpus) != 0)
+        {
+            Warn("pin to CPU", errno);
+            complete = false;
+        }
+    }
+
+    sched_param param;
+    param.sched_priority = std::max(::sched_get_priority_min(SCHED_FIFO),
+        std::min(priority, ::sched_get_priority_max(SCHED_FIFO)));
+    if (::sched_setscheduler(0, SCHED_FIFO, &param) != 0)
+    {
+        Warn("enable SCHED_FIFO", errno);
+        complete = false;
+    }
+
+    if (complete)
+    {
+        std::cout << "Real-time mode enabled, priority "
+                  << param.sched_priority << std::endl;
+    }
+    return complete;
+}
+
+/**
+ * Sleeps until a series of absolute deadlines and records how late each
+ * wakeup was.
+ *
+ * @param samples the number of wakeups to measure
+ * @param period_us the interval between deadlines
+ *
+ * @return statistics of the wakeup delays
+ */
+WakeupJitter MeasureWakeupJitter(unsigned samples, unsigned period_us)
+{
+    std::vector<double> delays;
+    delays.reserve(samples);
+
+    timespec deadline;
+    ::clock_gettime(CLOCK_MONOTONIC, &deadline);
+    for (unsigned i = 0; i < samples; i++)
+    {
+        deadline.tv_nsec += period_us * 1000L;
+        while (deadline.tv_nsec >= 1000000000L)
+        {
+            deadline.tv_nsec -= 1000000000L;
+            deadline.tv_sec++;
+        }
+        while (::clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, 0)
+               == EINTR)
+        {
+            // interrupted by a signal, the deadline is unchanged
+        }
+        delays.push_back(1e6 * (MonotonicSeconds() -
+            (deadline.tv_sec + deadline.tv_nsec * 1e-9)));
+    }
+
+    WakeupJitter result = { samples, 0, 0, 0, 0 };
+    if (delays.empty())
+        return result;
+
+    std::sort(delays.begin(), delays.end());
+    result.min_us = delays.front();
+    result.max_us = delays.back();
+    for (std::size_t i = 0; i < delays.size(); i++)
+        result.mean_us += delays[i] / delays.size();
+    result.p99_us = delays[(delays.size() * 99 - 1) / 100];
+
+    return result;
+}
+
+/**
+ * @param os the stream to print to
+ * @param jitter the measurement to print
+ *
+ * @return os
+ */
+std::ostream& operator<<(std::ostream& os, const WakeupJitter& jitter)
+{
+    return os << jitter.samples << " wakeups, latency (us): min "
+              << std::fixed << std::setprecision(1) << jitter.min_us
+              << "  mean " << jitter.mean_us
+              << "  p99 " << jitter.p99_us
+              << "  max " << jitter.max_us;
+}
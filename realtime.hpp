@@ -0,0 +1,52 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-
+ *
+ *  realtime.hpp
+ *
+ *  Author: desd-controller contributors
+ *
+ *  Modified version: this file is not part of the original desd-controller
+ *  sources by Michael Catanzaro <michael.catanzaro@mst.edu>.
+ *
+ *  These source code files were created at Missouri University of Science and
+ *  Technology, and are intended for use in teaching or research. They may be
+ *  freely copied, modified, and redistributed as long as modified versions are
+ *  clearly marked as such and this notice is not removed. Neither the authors
+ *  nor Missouri S&T make any warranty, express or implied, nor assume any legal
+ *  responsibility for the accuracy, completeness, or usefulness of these files
+ *  or any information distributed with these files.
+ *
+ *  Suggested modifications or questions about these files can be directed to
+ *  Dr. Bruce McMillin, Department of Computer Science, Missouri University of
+ *  Science and Technology, Rolla, MO 65409 <ff@mst.edu>.
+ */
+
+#ifndef REALTIME_HPP
+#define REALTIME_HPP
+
+#include <ostream>
+
+/**
+ * How late a thread woke up from a series of timed sleeps, in microseconds.
+ */
+struct WakeupJitter
+{
+    /// Number of wakeups measured
+    unsigned samples;
+    /// Smallest delay past the requested wakeup time
+    double min_us;
+    /// Average delay past the requested wakeup time
+    double mean_us;
+    /// 99th percentile delay past the requested wakeup time
+    double p99_us;
+    /// Largest delay past the requested wakeup time
+    double max_us;
+};
+
+/// Locks memory, pins the calling thread, and makes it real-time
+bool EnterRealtimeMode(int priority, int cpu);
+/// Measures the calling thread's wakeup latency
+WakeupJitter MeasureWakeupJitter(unsigned samples, unsigned period_us);
+/// Prints a jitter measurement
+std::ostream& operator<<(std::ostream& os, const WakeupJitter& jitter);
+
+#endif
@@ -0,0 +1,155 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-
+ *
+ *  sample-window.cpp
+ *
+ *  Author: desd-controller contributors
+ *
+ *  Modified version: this file is not part of the original desd-controller
+ *  sources by Michael Catanzaro <michael.catanzaro@mst.edu>.
+ *
+ *  These source code files were created at Missouri University of Science and
+ *  Technology, and are intended for use in teaching or research. They may be
+ *  freely copied, modified, and redistributed as long as modified versions are
+ *  clearly marked as such and this notice is not removed. Neither the authors
+ *  nor Missouri S&T make any warranty, express or implied, nor assume any legal
+ *  responsibility for the accuracy, completeness, or usefulness of these files
+ *  or any information distributed with these files.
+ *
+ *  Suggested modifications or questions about these files can be directed to
+ *  Dr. Bruce McMillin, Department of Computer Science, Missouri University of
+ *  Science and Technology, Rolla, MO 65409 <ff@mst.edu>.
+ */
+
+#include "sample-window.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+/**
+ * Converts a policy name to an AggregatePolicy
+ *
+ * @ErrorHandling throws std::runtime_error if the name is not recognized
+ *
+ * @param name one of last, mean, min, max, or rms
+ *
+ * @return the named policy
+ */
+AggregatePolicy ParseAggregatePolicy(const std::string& name)
+{
+    if (name == "last")
+        return AGGREGATE_LAST;
+    if (name == "mean")
+        return AGGREGATE_MEAN;
+    if (name == "min")
+        return AGGREGATE_MIN;
+    if (name == "max")
+        return AGGREGATE_MAX;
+    if (name == "rms")
+        return AGGREGATE_RMS;
+    throw std::runtime_error("Unknown aggregation policy: " + name);
+}
+
+/**
+ * @param policy which statistic to report
+ *
+ * @return the statistic selected by the policy
+ */
+float WindowStatistics::Aggregate(AggregatePolicy policy) const
+{
+    switch (policy)
+    {
+    case AGGREGATE_MEAN:
+        return mean;
+    case AGGREGATE_MIN:
+        return min;
+    case AGGREGATE_MAX:
+        return max;
+    case AGGREGATE_RMS:
+        return rms;
+    case AGGREGATE_LAST:
+    default:
+        return last;
+    }
+}
+
+SampleWindow::SampleWindow()
+    : m_next(0),
+      m_size(0)
+{
+}
+
+/**
+ * @param time when the sample was taken, in seconds on a monotonic clock
+ * @param value the sample
+ */
+void SampleWindow::Add(double time, float value)
+{
+    m_values[m_next] = value;
+    m_times[m_next] = time;
+    m_next = (m_next + 1) % CAPACITY;
+    if (m_size < CAPACITY)
+        m_size++;
+}
+
+void SampleWindow::Clear()
+{
+    m_next = 0;
+    m_size = 0;
+}
+
+std::size_t SampleWindow::Size() const
+{
+    return m_size;
+}
+
+/**
+ * Computes statistics over the window. Every statistic except the last sample
+ * is independent of sample order, so they are computed in two straight passes
+ * over the contiguous slots, one for the values and one for the times, rather
+ * than by walking around the ring.
+ *
+ * @return the statistics, all zero if the window is empty
+ */
+WindowStatistics SampleWindow::Compute() const
+{
+    WindowStatistics result = { m_size, 0, 0, 0, 0, 0, 0 };
+    if (m_size == 0)
+        return result;
+
+    const std::size_t n = m_size;
+    const float* values = m_values;
+    const double* times = m_times;
+
+    double sum = 0, sum_squares = 0;
+    float min = values[0], max = values[0];
+    for (std::size_t i = 0; i < n; i++)
+    {
+        sum += values[i];
+        sum_squares += static_cast<double>(values[i]) * values[i];
+        min = std::min(min, values[i]);
+        max = std::max(max, values[i]);
+    }
+
+    // Times relative to the first slot, to avoid cancellation in the slope
+    const double origin = times[0];
+    double sum_t = 0, sum_tt = 0, sum_tv = 0;
+    for (std::size_t i = 0; i < n; i++)
+    {
+        double t = times[i] - origin;
+        sum_t += t;
+        sum_tt += t * t;
+        sum_tv += t * values[i];
+    }
+
+    double denominator = n * sum_tt - sum_t * sum_t;
+    result.last = values[(m_next + CAPACITY - 1) % CAPACITY];
+    result.mean = sum / n;
+    result.min = min;
+    result.max = max;
+    result.rms = std::sqrt(sum_squares / n);
+    result.slope = denominator > 0 ? (n * sum_tv - sum_t * sum) / denominator
+                                   : 0;
+
+    return result;
+}
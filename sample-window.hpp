@@ -0,0 +1,101 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-
+ *
+ *  sample-window.hpp
+ *
+ *  Author: desd-controller contributors
+ *
+ *  Modified version: this file is not part of the original desd-controller
+ *  sources by Michael Catanzaro <michael.catanzaro@mst.edu>.
+ *
+ *  These source code files were created at Missouri University of Science and
+ *  Technology, and are intended for use in teaching or research. They may be
+ *  freely copied, modified, and redistributed as long as modified versions are
+ *  clearly marked as such and this notice is not removed. Neither the authors
+ *  nor Missouri S&T make any warranty, express or implied, nor assume any legal
+ *  responsibility for the accuracy, completeness, or usefulness of these files
+ *  or any information distributed with these files.
+ *
+ *  Suggested modifications or questions about these files can be directed to
+ *  Dr. Bruce McMillin, Department of Computer Science, Missouri University of
+ *  Science and Technology, Rolla, MO 65409 <ff@mst.edu>.
+ */
+
+#ifndef SAMPLE_WINDOW_HPP
+#define SAMPLE_WINDOW_HPP
+
+#include <cstddef>
+#include <string>
+
+/**
+ * How a window of samples is reduced to the single power level reported to
+ * the DGI.
+ */
+enum AggregatePolicy
+{
+    AGGREGATE_LAST,
+    AGGREGATE_MEAN,
+    AGGREGATE_MIN,
+    AGGREGATE_MAX,
+    AGGREGATE_RMS
+};
+
+/// Converts a policy name such as "mean" to an AggregatePolicy
+AggregatePolicy ParseAggregatePolicy(const std::string& name);
+
+/**
+ * Statistics over the samples in a window.
+ */
+struct WindowStatistics
+{
+    /// Number of samples in the window
+    std::size_t count;
+    /// Most recent sample
+    float last;
+    /// Arithmetic mean
+    float mean;
+    /// Smallest sample
+    float min;
+    /// Largest sample
+    float max;
+    /// Root mean square
+    float rms;
+    /// Least squares rate of change, per second
+    float slope;
+
+    /// Reduces the statistics to a single value
+    float Aggregate(AggregatePolicy policy) const;
+};
+
+/**
+ * A fixed-size ring of timestamped samples. Once full, each new sample
+ * replaces the oldest one.
+ */
+class SampleWindow
+{
+public:
+    /// Maximum number of samples in the window
+    static const std::size_t CAPACITY = 256;
+
+    /// Constructor
+    SampleWindow();
+    /// Adds a sample to the window
+    void Add(double time, float value);
+    /// Empties the window
+    void Clear();
+    /// Number of samples in the window
+    std::size_t Size() const;
+    /// Computes statistics over the window
+    WindowStatistics Compute() const;
+
+private:
+    /// Sample values; slots [0, m_size) are valid
+    float m_values[CAPACITY];
+    /// Sample times in seconds, parallel to m_values
+    double m_times[CAPACITY];
+    /// Slot the next sample goes into
+    std::size_t m_next;
+    /// Number of valid slots
+    std::size_t m_size;
+};
+
+#endif
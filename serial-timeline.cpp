@@ -0,0 +1,473 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-
+ *
+ *  serial-timeline.cpp
+ *
+ *  Author: desd-controller contributors
+ *
+ *  Modified version: this file is not part of the original desd-controller
+ *  sources by Michael Catanzaro <michael.catanzaro@mst.edu>.
+ *
+ *  These source code files were created at Missouri University of Science and
+ *  Technology, and are intended for use in teaching or research. They may be
+ *  freely copied, modified, and redistributed as long as modified versions are
+ *  clearly marked as such and this notice is not removed. Neither the authors
+ *  nor Missouri S&T make any warranty, express or implied, nor assume any legal
+ *  responsibility for the accuracy, completeness, or usefulness of these files
+ *  or any information distributed with these files.
+ *
+ *  Suggested modifications or questions about these files can be directed to
+ *  Dr. Bruce McMillin, Department of Computer Science, Missouri University of
+ *  Science and Technology, Rolla, MO 65409 <ff@mst.edu>.
+ */
+
+#include "serial-timeline.hpp"
+#include "monotonic-clock.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+namespace {
+
+/**
+ * @param filename a file name
+ * @param suffix a file name extension, including the dot
+ *
+ * @return true if filename ends with suffix
+ */
+bool EndsWith(const std::string& filename, const std::string& suffix)
+{
+    return filename.size() >= suffix.size() &&
+        filename.compare(filename.size() - suffix.size(), suffix.size(),
+                         suffix) == 0;
+}
+
+/**
+ * Formats a byte so that it needs no escaping in CSV or JSON
+ *
+ * @param byte the byte
+ *
+ * @return the character itself if alphanumeric, else its hex code
+ */
+std::string ByteName(char byte)
+{
+    unsigned char c = static_cast<unsigned char>(byte);
+    if (std::isalnum(c))
+        return std::string(1, byte);
+
+    std::ostringstream ss;
+    ss << "0x" << std::hex << std::setw(2) << std::setfill('0')
+       << static_cast<unsigned>(c);
+    return ss.str();
+}
+
+/**
+ * Latency totals for one command letter
+ */
+struct CommandStats
+{
+    /// Constructor
+    CommandStats()
+        : count(0), replies(0), transmit(0), first_byte(0), first_byte_max(0),
+          max_gap(0), total(0), total_max(0)
+    {
+    }
+
+    /// Number of times the command was sent
+    unsigned count;
+    /// Number of times the command was answered
+    unsigned replies;
+    /// Sum of transmit times
+    double transmit;
+    /// Sum of times to the first reply byte
+    double first_byte;
+    /// Longest time to the first reply byte
+    double first_byte_max;
+    /// Longest gap between reply bytes
+    double max_gap;
+    /// Sum of times to the last reply byte
+    double total;
+    /// Longest time to the last reply byte
+    double total_max;
+};
+
+}
+
+/**
+ * @param filename where Save() writes the timeline: Chrome trace-event JSON if
+ *        it ends in .json, otherwise CSV
+ * @param capacity maximum number of events to record
+ */
+SerialTimeline::SerialTimeline(const std::string& filename,
+                               std::size_t capacity)
+    : m_filename(filename),
+      m_events(capacity),
+      m_size(0),
+      m_full(false)
+{
+}
+
+void SerialTimeline::RecordWrite()
+{
+    Record(EVENT_WRITE, 0, 1e6 * MonotonicSeconds());
+}
+
+/**
+ * @param data the bytes
+ * @param size the number of bytes
+ */
+void SerialTimeline::RecordSent(const char* data, std::size_t size)
+{
+    double now = 1e6 * MonotonicSeconds();
+    for (std::size_t i = 0; i < size; i++)
+        Record(EVENT_SENT, data[i], now);
+}
+
+/**
+ * @param data the bytes
+ * @param size the number of bytes
+ */
+void SerialTimeline::RecordReceived(const char* data, std::size_t size)
+{
+    double now = 1e6 * MonotonicSeconds();
+    for (std::size_t i = 0; i < size; i++)
+        Record(EVENT_RECEIVED, data[i], now);
+}
+
+/**
+ * Writes the timeline to its file and prints per-command latencies. A file
+ * that cannot be written is reported, but the latencies are still printed.
+ */
+void SerialTimeline::Save()
+{
+    std::ofstream file(m_filename.c_str());
+    if (file)
+    {
+        if (EndsWith(m_filename, ".json"))
+            WriteChromeTrace(file);
+        else
+            WriteCsv(file);
+        file.close();
+    }
+
+    if (file)
+    {
+        std::cout << "Saved " << m_size << " serial events to " << m_filename
+                  << std::endl;
+    }
+    else
+    {
+        std::cerr << "Failed to save the serial timeline to " << m_filename
+                  << ": " << std::strerror(errno) << std::endl;
+    }
+    if (m_full)
+    {
+        std::cout << "The serial timeline filled up; later events were "
+                  << "dropped" << std::endl;
+    }
+    WriteSummary(std::cout);
+}
+
+/**
+ * @param type what happened
+ * @param byte the byte involved, if any
+ * @param time when it happened
+ */
+void SerialTimeline::Record(EventType type, char byte, double time)
+{
+    if (m_size == m_events.size())
+    {
+        m_full = true;
+        return;
+    }
+
+    Event& event = m_events[m_size++];
+    event.time = time;
+    event.type = type;
+    event.byte = byte;
+}
+
+/**
+ * Finds received bytes that belong to the reply before the command they are
+ * read after. The controller stops reading a reply at its delimiter, so the
+ * rest of the line is read, and timestamped, only after the next command, or
+ * may even still be arriving while it is transmitted, as when the DESD is
+ * polled back to back in sampling mode. So if a reply line was left unfinished
+ * when a command started, everything through the next line feed finishes that
+ * line. Such bytes are left out of the latency metrics.
+ *
+ * @return for each event, whether it is a stale received byte
+ */
+std::vector<bool> SerialTimeline::StaleBytes() const
+{
+    std::vector<bool> result(m_size, false);
+    bool commanded = false, line_open = false, finishing_line = false;
+
+    for (std::size_t i = 0; i < m_size; i++)
+    {
+        const Event& event = m_events[i];
+        switch (event.type)
+        {
+        case EVENT_WRITE:
+            // The intro prompt has no line ending, and is not a reply
+            if (commanded && line_open)
+                finishing_line = true;
+            commanded = true;
+            line_open = false;
+            break;
+        case EVENT_SENT:
+            break;
+        case EVENT_RECEIVED:
+            if (finishing_line)
+            {
+                result[i] = true;
+                if (event.byte == '\n')
+                    finishing_line = false;
+            }
+            else if (commanded)
+            {
+                line_open = event.byte != '\n';
+            }
+            break;
+        }
+    }
+
+    return result;
+}
+
+/**
+ * A write starts a new exchange unless it continues a command whose letter
+ * has not been sent yet. Received bytes belong to the latest exchange; any
+ * received before the first command, such as the intro prompt, belong to
+ * none.
+ *
+ * @param owners if not null, set to the index of the exchange each event
+ *        belongs to, or -1 for events that belong to none
+ *
+ * @return the exchanges, in order
+ */
+std::vector<SerialTimeline::Exchange>
+SerialTimeline::Exchanges(std::vector<long>* owners) const
+{
+    std::vector<Exchange> result;
+    std::vector<bool> stale = StaleBytes();
+    bool continuing = false;
+
+    if (owners)
+        owners->assign(m_size, -1);
+
+    for (std::size_t i = 0; i < m_size; i++)
+    {
+        const Event& event = m_events[i];
+        if (stale[i])
+            continue;
+
+        switch (event.type)
+        {
+        case EVENT_WRITE:
+            if (!continuing)
+            {
+                Exchange exchange = { 0, event.time, event.time, -1, 0, 0, 0 };
+                result.push_back(exchange);
+                continuing = true;
+            }
+            break;
+        case EVENT_SENT:
+            if (!result.empty())
+            {
+                result.back().command = event.byte;
+                result.back().sent_time = event.time;
+                continuing = !std::isalpha(
+                    static_cast<unsigned char>(event.byte));
+            }
+            break;
+        case EVENT_RECEIVED:
+            if (!result.empty())
+            {
+                Exchange& exchange = result.back();
+                if (exchange.first_reply_time < 0)
+                    exchange.first_reply_time = event.time;
+                else
+                    exchange.max_gap = std::max(exchange.max_gap,
+                        event.time - exchange.last_reply_time);
+                exchange.last_reply_time = event.time;
+                exchange.reply_bytes++;
+                continuing = false;
+            }
+            break;
+        }
+
+        if (owners)
+            (*owners)[i] = static_cast<long>(result.size()) - 1;
+    }
+
+    return result;
+}
+
+/**
+ * One row per byte, labelled with the command it belongs to. since_command_us
+ * is, for sent bytes, the time since the command's first write started, and
+ * for received bytes the time since the command finished transmitting. gap_us
+ * is the time since the previous received byte; it is left empty for sent
+ * bytes, since all the bytes of a write are drained, and timestamped,
+ * together. Received bytes that finish the reply to an earlier command are
+ * marked rx-stale and have no derived times.
+ *
+ * @param os where to write
+ */
+void SerialTimeline::WriteCsv(std::ostream& os) const
+{
+    os << "time_us,direction,byte,command,since_command_us,gap_us\n";
+    if (m_size == 0)
+        return;
+
+    const double origin = m_events[0].time;
+    std::vector<bool> stale = StaleBytes();
+    std::vector<long> owners;
+    std::vector<Exchange> exchanges = Exchanges(&owners);
+    double last_received = -1;
+
+    os << std::fixed << std::setprecision(1);
+    for (std::size_t i = 0; i < m_size; i++)
+    {
+        const Event& event = m_events[i];
+        if (event.type == EVENT_WRITE)
+            continue;
+        if (stale[i])
+        {
+            os << event.time - origin << ",rx-stale,"
+               << ByteName(event.byte) << ",,,\n";
+            continue;
+        }
+
+        bool sent = event.type == EVENT_SENT;
+        os << event.time - origin << ',' << (sent ? "tx" : "rx") << ','
+           << ByteName(event.byte) << ',';
+        if (owners[i] >= 0)
+        {
+            const Exchange& exchange = exchanges[owners[i]];
+            os << ByteName(exchange.command) << ',' << event.time -
+                (sent ? exchange.write_time : exchange.sent_time);
+        }
+        else
+        {
+            os << ',';
+        }
+        os << ',';
+        if (!sent && last_received >= 0)
+            os << event.time - last_received;
+        os << '\n';
+
+        if (!sent)
+            last_received = event.time;
+    }
+}
+
+/**
+ * Each command appears as a transmit span and a reply span annotated with its
+ * latencies, and each byte as an instant on a tx or rx track. Load the file
+ * in chrome://tracing or Perfetto.
+ *
+ * @param os where to write
+ */
+void SerialTimeline::WriteChromeTrace(std::ostream& os) const
+{
+    const double origin = m_size > 0 ? m_events[0].time : 0;
+    const char* separator = "\n";
+
+    os << std::fixed << std::setprecision(1) << "{\"traceEvents\":[";
+
+    std::vector<Exchange> exchanges = Exchanges();
+    for (std::size_t i = 0; i < exchanges.size(); i++)
+    {
+        const Exchange& e = exchanges[i];
+        std::string name = ByteName(e.command);
+
+        os << separator << "{\"name\":\"transmit " << name
+           << "\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":"
+           << e.write_time - origin << ",\"dur\":"
+           << e.sent_time - e.write_time << "}";
+        separator = ",\n";
+
+        if (e.reply_bytes > 0)
+        {
+            os << separator << "{\"name\":\"reply " << name
+               << "\",\"ph\":\"X\",\"pid\":1,\"tid\":2,\"ts\":"
+               << e.sent_time - origin << ",\"dur\":"
+               << e.last_reply_time - e.sent_time
+               << ",\"args\":{\"first_byte_us\":"
+               << e.first_reply_time - e.sent_time
+               << ",\"max_gap_us\":" << e.max_gap
+               << ",\"bytes\":" << e.reply_bytes << "}}";
+        }
+    }
+
+    for (std::size_t i = 0; i < m_size; i++)
+    {
+        const Event& event = m_events[i];
+        if (event.type == EVENT_WRITE)
+            continue;
+
+        os << separator << "{\"name\":\"" << ByteName(event.byte)
+           << "\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":"
+           << (event.type == EVENT_SENT ? 3 : 4) << ",\"ts\":"
+           << event.time - origin << "}";
+        separator = ",\n";
+    }
+
+    os << "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"tracks\":"
+       << "\"1=transmit 2=reply 3=tx bytes 4=rx bytes\"}}\n";
+}
+
+/**
+ * @param os where to print
+ */
+void SerialTimeline::WriteSummary(std::ostream& os) const
+{
+    std::map<char, CommandStats> stats;
+    std::vector<Exchange> exchanges = Exchanges();
+
+    for (std::size_t i = 0; i < exchanges.size(); i++)
+    {
+        const Exchange& e = exchanges[i];
+        CommandStats& s = stats[e.command];
+        s.count++;
+        s.transmit += e.sent_time - e.write_time;
+        if (e.reply_bytes == 0)
+            continue;
+
+        double first_byte = e.first_reply_time - e.sent_time;
+        double total = e.last_reply_time - e.sent_time;
+        s.replies++;
+        s.first_byte += first_byte;
+        s.first_byte_max = std::max(s.first_byte_max, first_byte);
+        s.max_gap = std::max(s.max_gap, e.max_gap);
+        s.total += total;
+        s.total_max = std::max(s.total_max, total);
+    }
+
+    os << "command  count  transmit ms  first byte ms (mean/max)  "
+       << "max gap ms  reply ms (mean/max)\n";
+    os << std::fixed << std::setprecision(2);
+    for (std::map<char, CommandStats>::const_iterator it = stats.begin();
+         it != stats.end(); ++it)
+    {
+        const CommandStats& s = it->second;
+        double replies = s.replies > 0 ? s.replies : 1;
+        os << std::setw(7) << ByteName(it->first)
+           << std::setw(7) << s.count
+           << std::setw(13) << s.transmit / s.count / 1e3
+           << std::setw(14) << s.first_byte / replies / 1e3
+           << " / " << std::setw(8) << s.first_byte_max / 1e3
+           << std::setw(14) << s.max_gap / 1e3
+           << std::setw(11) << s.total / replies / 1e3
+           << " / " << std::setw(8) << s.total_max / 1e3 << "\n";
+    }
+    os.flush();
+}
@@ -0,0 +1,242 @@
+/* -*- Mode: C++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*-
+ *
+ *  serial-timeline.hpp
+ *
+ *  Author: desd-controller contributors
+ *
+ *  Modified version: this file is not part of the original desd-controller
+ *  sources by Michael Catanzaro <michael.catanzaro@mst.edu>.
+ *
+ *  These source code files were created at Missouri University of Science and
+ *  Technology, and are intended for use in teaching or research. They may be
+ *  freely copied, modified, and redistributed as long as modified versions are
+ *  clearly marked as such and this notice is not removed. Neither the authors
+ *  nor Missouri S&T make any warranty, express or implied, nor assume any legal
+ *  responsibility for the accuracy, completeness, or usefulness of these files
+ *  or any information distributed with these files.
+ *
+ *  Suggested modifications or questions about these files can be directed to
+ *  Dr. Bruce McMillin, Department of Computer Science, Missouri University of
+ *  Science and Technology, Rolla, MO 65409 <ff@mst.edu>.
+ */
+
+#ifndef SERIAL_TIMELINE_HPP
+#define SERIAL_TIMELINE_HPP
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <boost/asio/buffer.hpp>
+#include <boost/system/error_code.hpp>
+#include <boost/system/system_error.hpp>
+#include <boost/throw_exception.hpp>
+#include <termios.h>
+
+/**
+ * Records when each byte crosses a serial link, and derives per-command
+ * latencies from the record. Events go into a buffer allocated up front;
+ * once it is full, later events are dropped. Nothing is written out until
+ * Save() is called, so the I/O path never blocks on the file.
+ */
+class SerialTimeline
+{
+public:
+    /// Constructor
+    SerialTimeline(const std::string& filename, std::size_t capacity);
+    /// Notes that a write is starting
+    void RecordWrite();
+    /// Records bytes that have been transmitted
+    void RecordSent(const char* data, std::size_t size);
+    /// Records bytes that have been received
+    void RecordReceived(const char* data, std::size_t size);
+    /// Writes the timeline to its file and prints a summary
+    void Save();
+
+private:
+    /// What happened at an instant on the link
+    enum EventType
+    {
+        EVENT_WRITE,
+        EVENT_SENT,
+        EVENT_RECEIVED
+    };
+
+    /// One timestamped event
+    struct Event
+    {
+        /// Microseconds on the monotonic clock
+        double time;
+        /// What happened
+        EventType type;
+        /// The byte sent or received
+        char byte;
+    };
+
+    /// One command and the reply to it
+    struct Exchange
+    {
+        /// The command letter
+        char command;
+        /// When the first write of the command started
+        double write_time;
+        /// When the last byte of the command was transmitted
+        double sent_time;
+        /// When the first byte of the reply arrived, or negative
+        double first_reply_time;
+        /// When the last byte of the reply arrived
+        double last_reply_time;
+        /// Longest gap between consecutive reply bytes
+        double max_gap;
+        /// Number of reply bytes
+        std::size_t reply_bytes;
+    };
+
+    /// Appends one event, if there is room
+    void Record(EventType type, char byte, double time);
+    /// Finds received bytes that finish the reply to an earlier command
+    std::vector<bool> StaleBytes() const;
+    /// Groups the events into exchanges
+    std::vector<Exchange> Exchanges(std::vector<long>* owners = 0) const;
+    /// Writes the events as comma-separated values
+    void WriteCsv(std::ostream& os) const;
+    /// Writes the events as Chrome trace-event JSON
+    void WriteChromeTrace(std::ostream& os) const;
+    /// Prints latency statistics for each command letter
+    void WriteSummary(std::ostream& os) const;
+
+    /// Where to save the timeline
+    std::string m_filename;
+    /// Preallocated event buffer
+    std::vector<Event> m_events;
+    /// Number of valid events in m_events
+    std::size_t m_size;
+    /// Whether events have been dropped because the buffer was full
+    bool m_full;
+};
+
+/**
+ * A decorator for a serial stream that records every byte in a
+ * SerialTimeline. With a null timeline it passes I/O straight through.
+ *
+ * Each write is drained before it is recorded, so sent bytes are timestamped
+ * when they have left the serial driver rather than when they were queued.
+ * Received bytes are timestamped when read_some returns them, which at 9600
+ * baud is typically one or a few bytes at a time.
+ */
+template <typename Stream>
+class TimelineStream
+{
+public:
+    /**
+     * Constructor
+     *
+     * @param next the stream to perform the actual I/O on
+     * @param timeline where to record bytes, or null to record nothing
+     */
+    TimelineStream(Stream& next, SerialTimeline* timeline)
+        : m_next(next),
+          m_timeline(timeline)
+    {
+    }
+
+    /**
+     * Reads some data from the stream, recording it
+     *
+     * @ErrorHandling throws boost::system::system_error on failure
+     *
+     * @param buffers where to put the data
+     *
+     * @return number of bytes read
+     */
+    template <typename MutableBufferSequence>
+    std::size_t read_some(const MutableBufferSequence& buffers)
+    {
+        boost::system::error_code ec;
+        std::size_t result = read_some(buffers, ec);
+        if (ec)
+            boost::throw_exception(boost::system::system_error(ec));
+        return result;
+    }
+
+    /**
+     * Reads some data from the stream, recording it
+     *
+     * @param buffers where to put the data
+     * @param ec set to indicate what error occurred, if any
+     *
+     * @return number of bytes read
+     */
+    template <typename MutableBufferSequence>
+    std::size_t read_some(const MutableBufferSequence& buffers,
+                          boost::system::error_code& ec)
+    {
+        std::size_t result = m_next.read_some(buffers, ec);
+        if (m_timeline && result > 0)
+        {
+            // read_some fills the first buffer first, and returns at most its
+            // size for the single-buffer sequences a streambuf provides
+            boost::asio::mutable_buffer buffer = *buffers.begin();
+            m_timeline->RecordReceived(
+                boost::asio::buffer_cast<const char*>(buffer), result);
+        }
+        return result;
+    }
+
+    /**
+     * Writes some data to the stream, recording it
+     *
+     * @ErrorHandling throws boost::system::system_error on failure
+     *
+     * @param buffers the data to write
+     *
+     * @return number of bytes written
+     */
+    template <typename ConstBufferSequence>
+    std::size_t write_some(const ConstBufferSequence& buffers)
+    {
+        boost::system::error_code ec;
+        std::size_t result = write_some(buffers, ec);
+        if (ec)
+            boost::throw_exception(boost::system::system_error(ec));
+        return result;
+    }
+
+    /**
+     * Writes some data to the stream, and waits for it to be transmitted if
+     * it is being recorded
+     *
+     * @param buffers the data to write
+     * @param ec set to indicate what error occurred, if any
+     *
+     * @return number of bytes written
+     */
+    template <typename ConstBufferSequence>
+    std::size_t write_some(const ConstBufferSequence& buffers,
+                           boost::system::error_code& ec)
+    {
+        if (!m_timeline)
+            return m_next.write_some(buffers, ec);
+
+        // Write just the first buffer, so we know which bytes went out
+        boost::asio::const_buffer buffer = *buffers.begin();
+        m_timeline->RecordWrite();
+        std::size_t result = m_next.write_some(boost::asio::buffer(buffer), ec);
+        if (result > 0)
+        {
+            ::tcdrain(m_next.native_handle());
+            m_timeline->RecordSent(
+                boost::asio::buffer_cast<const char*>(buffer), result);
+        }
+        return result;
+    }
+
+private:
+    /// The stream that performs the actual I/O
+    Stream& m_next;
+    /// Where to record bytes, may be null
+    SerialTimeline* m_timeline;
+};
+
+#endif